@@ -1,270 +1,409 @@
 #pragma once
+#include <iostream>
 #include <stdexcept>
 #include "./BSTNode.hpp"
+#include "./NodePool.hpp"
 
+/*
+    * AVL tree whose nodes live in a NodePool shared with other trees.
+    * The tree itself is only the index of its root, so every operation
+    * takes the pool holding its nodes.
+*/
 template <typename K, typename V>
 class BST {
  private:
-    BSTNode<K, V>* root;
+    static constexpr uint32_t NIL = BSTNode<K, V>::NIL;
+
+    uint32_t root;
 
     /*
         * Get height of node
+        * @param pool pool holding the nodes
         * @param node node to get height of
         * @return height of node
     */
-    int height(BSTNode<K, V>* node) const {
-        return node ? node->height : 0;
+    static int height(const NodePool<K, V>& pool, uint32_t node) {
+        return node != NIL ? pool[node].height : 0;
     }
 
     /*
         * Update height of node
+        * @param pool pool holding the nodes
         * @param node node to update height of
     */
-    void updateHeight(BSTNode<K, V>* node) {
-        node->height =
-            (height(node->left) > height(node->right)
-         ? height(node->left) : height(node->right)) + 1;
+    static void updateHeight(NodePool<K, V>& pool, uint32_t node) {
+        BSTNode<K, V>& n = pool[node];
+        n.height =
+            (height(pool, n.left) > height(pool, n.right)
+         ? height(pool, n.left) : height(pool, n.right)) + 1;
     }
 
     /*
         * Rotate BST right
+        * @param pool pool holding the nodes
         * @param y node to rotate
         * @return rotated node
     */
-    BSTNode<K, V>* rotateRight(BSTNode<K, V>* y) {
-        BSTNode<K, V>* x = y->left;
-        y->left = x->right;
-        x->right = y;
-        updateHeight(y);
-        updateHeight(x);
+    static uint32_t rotateRight(NodePool<K, V>& pool, uint32_t y) {
+        uint32_t x = pool[y].left;
+        pool[y].left = pool[x].right;
+        pool[x].right = y;
+        updateHeight(pool, y);
+        updateHeight(pool, x);
         return x;
     }
 
     /*
         * Rotate BST left
+        * @param pool pool holding the nodes
         * @param x node to rotate
         * @return rotated node
     */
-    BSTNode<K, V>* rotateLeft(BSTNode<K, V>* x) {
-        BSTNode<K, V>* y = x->right;
-        x->right = y->left;
-        y->left = x;
-        updateHeight(x);
-        updateHeight(y);
+    static uint32_t rotateLeft(NodePool<K, V>& pool, uint32_t x) {
+        uint32_t y = pool[x].right;
+        pool[x].right = pool[y].left;
+        pool[y].left = x;
+        updateHeight(pool, x);
+        updateHeight(pool, y);
         return y;
     }
 
     /*
         * Balance BST
+        * @param pool pool holding the nodes
         * @param node node to balance
         * @return balanced node
     */
-    BSTNode<K, V>* balance(BSTNode<K, V>* node) {
-        updateHeight(node);
+    static uint32_t balance(NodePool<K, V>& pool, uint32_t node) {
+        updateHeight(pool, node);
+        BSTNode<K, V>& n = pool[node];
         int balanceFactor =
-         height(node->left) - height(node->right);
+         height(pool, n.left) - height(pool, n.right);
 
         if (balanceFactor > 1) {
-            if (height(node->left->left)
-             < height(node->left->right)) {
-                node->left = rotateLeft(node->left);
+            if (height(pool, pool[n.left].left)
+             < height(pool, pool[n.left].right)) {
+                n.left = rotateLeft(pool, n.left);
             }
-            return rotateRight(node);
+            return rotateRight(pool, node);
         }
         if (balanceFactor < -1) {
-            if (height(node->right->right)
-             < height(node->right->left)) {
-                node->right = rotateRight(node->right);
+            if (height(pool, pool[n.right].right)
+             < height(pool, pool[n.right].left)) {
+                n.right = rotateRight(pool, n.right);
             }
-            return rotateLeft(node);
+            return rotateLeft(pool, node);
         }
         return node;
     }
 
     /*
         * Insert key-value pair into BST
+        * @param pool pool holding the nodes
         * @param node node to insert into
         * @param key key to insert
         * @param value value to insert
+        * @param inserted set to true if a new node was created
         * @return node with inserted key-value pair
     */
-    BSTNode<K, V>* insert(BSTNode<K, V>* node,
-         const K& key, const V& value) {
-        if (!node)
-            return new BSTNode<K, V>(key, value);
-
-        if (key < node->key) {
-            node->left = insert(node->left, key, value);
-        } else if (key > node->key) {
-            node->right = insert(node->right, key, value);
+    static uint32_t insert(NodePool<K, V>& pool, uint32_t node,
+         const K& key, const V& value, bool& inserted) {
+        if (node == NIL) {
+            inserted = true;
+            return pool.allocate(key, value);
+        }
+
+        // Slabs never move, so the reference survives the allocation
+        BSTNode<K, V>& n = pool[node];
+        if (key < n.key) {
+            n.left = insert(pool, n.left, key, value, inserted);
+        } else if (key > n.key) {
+            n.right = insert(pool, n.right, key, value, inserted);
         } else {
-            node->value = value;  // Update value if key already exists
+            n.value = value;  // Update value if key already exists
+            return node;
         }
 
-        return balance(node);
+        return balance(pool, node);
+    }
+
+    /*
+        * Link an allocated node into BST, its key must not be present
+        * @param pool pool holding the nodes
+        * @param node node to insert into
+        * @param leaf node to link
+        * @return node with leaf linked in
+    */
+    static uint32_t link(NodePool<K, V>& pool, uint32_t node,
+     uint32_t leaf) {
+        if (node == NIL) {
+            pool[leaf].left = NIL;
+            pool[leaf].right = NIL;
+            pool[leaf].height = 1;
+            return leaf;
+        }
+        BSTNode<K, V>& n = pool[node];
+        if (pool[leaf].key < n.key) {
+            n.left = link(pool, n.left, leaf);
+        } else {
+            n.right = link(pool, n.right, leaf);
+        }
+        return balance(pool, node);
     }
 
     /*
         * Find minimum node in BST
+        * @param pool pool holding the nodes
         * @param node node to start search from
         * @return minimum node
     */
-    BSTNode<K, V>* findMin(BSTNode<K, V>* node) const {
-        return node->left ? findMin(node->left) : node;
+    static uint32_t findMin(const NodePool<K, V>& pool, uint32_t node) {
+        return pool[node].left != NIL ? findMin(pool, pool[node].left) : node;
     }
 
     /*
         * Remove minimum node in BST
+        * @param pool pool holding the nodes
         * @param node node to start search from
         * @return node with minimum node removed
     */
-    BSTNode<K, V>* removeMin(BSTNode<K, V>* node) {
-        if (!node->left) {
-            return node->right;
+    static uint32_t removeMin(NodePool<K, V>& pool, uint32_t node) {
+        if (pool[node].left == NIL) {
+            return pool[node].right;
         }
-        node->left = removeMin(node->left);
-        return balance(node);
+        pool[node].left = removeMin(pool, pool[node].left);
+        return balance(pool, node);
     }
 
     /*
         * Remove key from BST
+        * @param pool pool holding the nodes
         * @param node node to remove key from
         * @param key key to remove
+        * @param removed set to true if a node was released
         * @return node with key removed
     */
-    BSTNode<K, V>* remove(BSTNode<K, V>* node, const K& key) {
-        if (!node) return nullptr;
+    static uint32_t remove(NodePool<K, V>& pool, uint32_t node,
+     const K& key, bool& removed) {
+        if (node == NIL) return NIL;
 
-        if (key < node->key) {
-            node->left = remove(node->left, key);
-        } else if (key > node->key) {
-            node->right = remove(node->right, key);
+        BSTNode<K, V>& n = pool[node];
+        if (key < n.key) {
+            n.left = remove(pool, n.left, key, removed);
+        } else if (key > n.key) {
+            n.right = remove(pool, n.right, key, removed);
         } else {
-            BSTNode<K, V>* left = node->left;
-            BSTNode<K, V>* right = node->right;
-            delete node;
-            if (!right) return left;
-            BSTNode<K, V>* min = findMin(right);
-            min->right = removeMin(right);
-            min->left = left;
-            return balance(min);
+            uint32_t left = n.left;
+            uint32_t right = n.right;
+            pool.release(node);
+            removed = true;
+            if (right == NIL) return left;
+            uint32_t min = findMin(pool, right);
+            pool[min].right = removeMin(pool, right);
+            pool[min].left = left;
+            return balance(pool, min);
         }
-        return balance(node);
+        return balance(pool, node);
     }
 
     /*
-        * Search for key in BST
-        * @param node node to search from
-        * @param key key to search for
-        * @return node with key
+        * Inorder traversal of BST
+        * @param pool pool holding the nodes
+        * @param node node to start traversal from
+        * @param visit function to call on each node
     */
-    BSTNode<K, V>* search(BSTNode<K, V>* node,
-     const K& key) const {
-        if (!node || node->key == key)
-            return node;
-        if (key < node->key)
-            return search(node->left, key);
-        return search(node->right, key);
+    template <typename Visit>
+    static void inorder(NodePool<K, V>& pool, uint32_t node, Visit& visit) {
+        if (node == NIL) return;
+        inorder(pool, pool[node].left, visit);
+        visit(&pool[node]);
+        inorder(pool, pool[node].right, visit);
     }
 
     /*
-        * Inorder traversal of BST
-        * @param node node to start traversal from
-        * @param visit function to call on each node
+        * Release every node of a subtree
+        * @param pool pool holding the nodes
+        * @param node root of the subtree
     */
-    void inorder(BSTNode<K, V>* node,
-     void (*visit)(BSTNode<K, V>*)) const {
-        if (!node) return;
-        inorder(node->left, visit);
-        visit(node);
-        inorder(node->right, visit);
+    static void release(NodePool<K, V>& pool, uint32_t node) {
+        if (node == NIL) return;
+        release(pool, pool[node].left);
+        release(pool, pool[node].right);
+        pool.release(node);
+    }
+
+    /*
+        * Collect nodes of a subtree in key order
+        * @param pool pool holding the nodes
+        * @param node root of the subtree
+        * @param keys array receiving keys
+        * @param nodes array receiving node indices
+        * @param count number of nodes collected so far, updated
+    */
+    static void detach(const NodePool<K, V>& pool, uint32_t node,
+     K* keys, uint32_t* nodes, size_t& count) {
+        if (node == NIL) return;
+        detach(pool, pool[node].left, keys, nodes, count);
+        keys[count] = pool[node].key;
+        nodes[count] = node;
+        ++count;
+        detach(pool, pool[node].right, keys, nodes, count);
     }
 
  public:
     /*
-        * Constructor
+        * Constructor of an empty tree
     */
-    BST() : root(nullptr) {}
+    BST() : root(NIL) {}
+
+    /*
+        * Check if tree has no nodes
+        * @return bool
+    */
+    bool empty() const {
+        return root == NIL;
+    }
+
+    /*
+        * Get height of the tree
+        * @param pool pool holding the nodes
+        * @return height, 0 for an empty tree
+    */
+    int height(const NodePool<K, V>& pool) const {
+        return height(pool, root);
+    }
 
     /*
         * Insert key-value pair into BST
+        * @param pool pool holding the nodes
         * @param key key to insert
         * @param value value to insert
+        * @return true if key was new, false if its value was replaced
+    */
+    bool insert(NodePool<K, V>& pool, const K& key, const V& value) {
+        bool inserted = false;
+        root = insert(pool, root, key, value, inserted);
+        return inserted;
+    }
+
+    /*
+        * Insert a node allocated from the pool, its key must not be present
+        * @param pool pool holding the nodes
+        * @param node index of the node
     */
-    void insert(const K& key, const V& value) {
-        root = insert(root, key, value);
+    void insertNode(NodePool<K, V>& pool, uint32_t node) {
+        root = link(pool, root, node);
     }
 
     /*
         * Remove key from BST
+        * @param pool pool holding the nodes
         * @param key key to remove
+        * @return true if key was found and removed
     */
-    void remove(const K& key) {
-        root = remove(root, key);
+    bool remove(NodePool<K, V>& pool, const K& key) {
+        bool removed = false;
+        root = remove(pool, root, key, removed);
+        return removed;
+    }
+
+    /*
+        * Find node holding key
+        * @param pool pool holding the nodes
+        * @param key key to search for
+        * @return node with key or NIL
+    */
+    uint32_t find(const NodePool<K, V>& pool, const K& key) const {
+        uint32_t node = root;
+        while (node != NIL && pool[node].key != key) {
+            node = key < pool[node].key ? pool[node].left : pool[node].right;
+        }
+        return node;
     }
 
     /*
         * Search for key in BST
+        * @param pool pool holding the nodes
         * @param key key to search for
         * @return value associated with key
         * @throws std::out_of_range if key not found
     */
-    V search(const K& key) const {
-        BSTNode<K, V>* result = search(root, key);
-        if (!result) throw std::out_of_range("Key not found");
-        return result->value;
+    V search(const NodePool<K, V>& pool, const K& key) const {
+        uint32_t result = find(pool, key);
+        if (result == NIL) throw std::out_of_range("Key not found");
+        return pool[result].value;
     }
 
     /*
         * Check if key exists in BST
+        * @param pool pool holding the nodes
         * @param key key to search for
         * @return bool
     */
-    bool exists(const K& key) const {
-        return search(root, key) != nullptr;
+    bool exists(const NodePool<K, V>& pool, const K& key) const {
+        return find(pool, key) != NIL;
     }
 
     /*
         * Perform inorder traversal of BST
+        * @param pool pool holding the nodes
+        * @param visit function to call on each node
+    */
+    template <typename Visit>
+    void inorder(NodePool<K, V>& pool, Visit visit) const {
+        inorder(pool, root, visit);
+    }
+
+    /*
+        * Return every node of the tree to the pool, leaving it empty.
+        * Not needed before dropping the whole pool.
+        * @param pool pool holding the nodes
+    */
+    void clear(NodePool<K, V>& pool) {
+        release(pool, root);
+        root = NIL;
+    }
+
+    /*
+        * Hand every node over to the caller in key order, leaving the
+        * tree empty. The nodes stay allocated in the pool.
+        * @param pool pool holding the nodes
+        * @param keys array receiving keys, large enough for the tree
+        * @param nodes array receiving node indices
+        * @return number of nodes detached
     */
-    void inorder(void (*visit)(BSTNode<K, V>*)) const {
-        inorder(root, visit);
+    size_t detach(const NodePool<K, V>& pool, K* keys, uint32_t* nodes) {
+        size_t count = 0;
+        detach(pool, root, keys, nodes, count);
+        root = NIL;
+        return count;
     }
 
     /*
         * Print BST
     */
-    void print(
-        BSTNode<K, V>* node, int space = 0, int increment = 10)
+    void print(const NodePool<K, V>& pool,
+        uint32_t node, int space = 0, int increment = 10)
          const {
-        if (node == nullptr)
+        if (node == NIL)
             return;
 
         space += increment;
 
-        print(node->right, space);
+        print(pool, pool[node].right, space);
 
         std::cout << std::endl;
         for (int i = increment; i < space; i++)
             std::cout << " ";
-        std::cout << node->key << "\n";
+        std::cout << pool[node].key << "\n";
 
-        print(node->left, space);
+        print(pool, pool[node].left, space);
     }
 
     /*
         * Callable Print BST
     */
-    void print() const {
-        print(root);
-    }
-
-    /*
-        * Destructor
-    */
-    ~BST() {
-        while (root) {
-            remove(root->key);
-        }
+    void print(const NodePool<K, V>& pool) const {
+        print(pool, root);
     }
 };
@@ -1,14 +1,19 @@
 #pragma once
+#include <cstdint>
 
 template <typename K, typename V>
 class BSTNode {
  public:
+    static constexpr uint32_t NIL = UINT32_MAX;  // index of no node
+
     K key;
     V value;
-    BSTNode* left;
-    BSTNode* right;
+    uint32_t left;   // index into the owning NodePool
+    uint32_t right;  // index into the owning NodePool
     int height;
 
+    BSTNode() : key(), value(), left(NIL), right(NIL), height(1) {}
+
     BSTNode(const K& k, const V& v)
-        : key(k), value(v), left(nullptr), right(nullptr), height(1) {}
+        : key(k), value(v), left(NIL), right(NIL), height(1) {}
 };
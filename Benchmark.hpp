@@ -0,0 +1,547 @@
+#pragma once
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "./PerfCounters.hpp"
+
+/*
+    * Benchmark harness: operations are timed in batches, so one clock read
+    * is spread over thousands of operations, and the mean time per
+    * operation of every batch goes into a log-linear latency histogram.
+    * Its percentiles are therefore those of batch means, which smooth out
+    * single slow operations; operations whose tail matters more than
+    * their clock overhead are timed one by one, as batches of one.
+    * Results are written as CSV and JSON rows per structure, operation,
+    * size and data set, with hardware event counts per operation when
+    * built with -DPERF_COUNTERS.
+*/
+
+/*
+    * HDR-style histogram of latencies in picoseconds. Values below 128
+    * are counted exactly; above that every power of two is split into 64
+    * buckets, so a reported value is within 1.6% of the recorded one.
+*/
+class LatencyHistogram {
+ private:
+    static constexpr unsigned SUB_BITS = 7;
+    static constexpr uint64_t SUB_COUNT = 1ull << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t minValue;
+    uint64_t maxValue;
+    long double sum;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < SUB_COUNT)
+            return static_cast<size_t>(value);
+        unsigned shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+        return static_cast<size_t>(shift * HALF_COUNT + (value >> shift));
+    }
+
+    /*
+        * Highest value counted in a bucket
+        * @param index bucket index
+        * @return value in picoseconds
+    */
+    static uint64_t valueAt(size_t index) {
+        if (index < SUB_COUNT)
+            return index;
+        unsigned shift = static_cast<unsigned>(index / HALF_COUNT - 1);
+        uint64_t sub = index % HALF_COUNT + HALF_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+ public:
+    /*
+        * Constructor of an empty histogram
+    */
+    LatencyHistogram()
+        : counts(indexOf(UINT64_MAX) + 1, 0), total(0),
+          minValue(UINT64_MAX), maxValue(0), sum(0) {}
+
+    /*
+        * Count one value
+        * @param picoseconds value to count
+    */
+    void record(uint64_t picoseconds) {
+        ++counts[indexOf(picoseconds)];
+        ++total;
+        minValue = std::min(minValue, picoseconds);
+        maxValue = std::max(maxValue, picoseconds);
+        sum += picoseconds;
+    }
+
+    /*
+        * Add every value counted by another histogram
+        * @param other histogram to add
+    */
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+        sum += other.sum;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    double mean() const {
+        return total ? static_cast<double>(sum / total) : 0;
+    }
+
+    /*
+        * Value below which a fraction of the counted values lie
+        * @param p fraction in [0, 1]
+        * @return value in picoseconds, 0 for an empty histogram
+    */
+    uint64_t percentile(double p) const {
+        if (total == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(valueAt(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    /*
+        * Call visit(highest value, count) for every non-empty bucket
+        * @param visit function called in increasing order of values
+    */
+    template <typename Visit>
+    void forEachBucket(Visit visit) const {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] != 0)
+                visit(std::min(valueAt(i), maxValue), counts[i]);
+        }
+    }
+};
+
+/*
+    * Time one batch of operations
+    * @param operations number of operations the batch performs
+    * @param batch function performing them
+    * @return mean time per operation in picoseconds
+*/
+template <typename Batch>
+uint64_t timeBatch(size_t operations, Batch batch) {
+    auto start = std::chrono::steady_clock::now();
+    batch();
+    auto end = std::chrono::steady_clock::now();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+     end - start).count();
+    return ns * 1000 / operations;
+}
+
+/*
+    * Time `batches` batches of operations after `warmup` untimed ones and
+    * count the mean time per operation of every batch
+    * @param histogram histogram the batch means are counted in
+    * @param warmup number of untimed batches run first
+    * @param batches number of timed batches
+    * @param operations number of operations each batch performs
+    * @param batch function performing batch number i, warmup batches
+    * included
+*/
+template <typename Batch>
+void timeBatches(LatencyHistogram& histogram, size_t warmup, size_t batches,
+ size_t operations, Batch batch) {
+    for (size_t i = 0; i < warmup; ++i) {
+        batch(i);
+    }
+    for (size_t i = warmup; i < warmup + batches; ++i) {
+        histogram.record(timeBatch(operations, [&]() { batch(i); }));
+    }
+}
+
+/*
+    * Time batches like timeBatches above, counting hardware events over
+    * the timed batches, clock reads included
+    * @param histogram histogram the batch means are counted in
+    * @param counters counters running during the timed batches
+    * @param warmup number of untimed batches run first
+    * @param batches number of timed batches
+    * @param operations number of operations each batch performs
+    * @param batch function performing batch number i
+*/
+template <typename Batch>
+void timeBatches(LatencyHistogram& histogram, PerfCounters& counters,
+ size_t warmup, size_t batches, size_t operations, Batch batch) {
+    for (size_t i = 0; i < warmup; ++i) {
+        batch(i);
+    }
+    counters.start();
+    for (size_t i = warmup; i < warmup + batches; ++i) {
+        histogram.record(timeBatch(operations, [&]() { batch(i); }));
+    }
+    counters.stop();
+}
+
+/*
+    * Time every operation on its own, for operations whose rare slow ones
+    * a batch mean would hide, such as an insert that grows the table
+    * @param histogram histogram the times are counted in
+    * @param counters counters running during the operations, clock reads
+    * included
+    * @param operations number of operations
+    * @param operation function performing operation number i
+*/
+template <typename Operation>
+void timeEach(LatencyHistogram& histogram, PerfCounters& counters,
+ size_t operations, Operation operation) {
+    counters.start();
+    for (size_t i = 0; i < operations; ++i) {
+        histogram.record(timeBatch(1, [&]() { operation(i); }));
+    }
+    counters.stop();
+}
+
+/*
+    * Pin the calling thread to one CPU, so timings do not include
+    * migrations between cores
+    * @param cpu CPU index
+    * @return false if the thread could not be pinned
+*/
+inline bool pinToCpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/*
+    * Settings of a benchmark run, read from the command line
+*/
+struct BenchmarkOptions {
+    std::vector<std::string> structures;  // empty for every structure
+    std::vector<int> sizes = {1000, 2000, 4000, 8000, 16000, 32000, 64000,
+     128000, 256000};
+    std::vector<int> dataSets = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    size_t batchSize = 1000;
+    size_t batches = 100;
+    size_t warmup = 10;
+    int cpu = -1;  // no pinning
+    std::string csvPath = "benchmark.csv";
+    std::string jsonPath = "benchmark.json";
+    std::vector<std::string> workloads;  // empty for every workload
+    size_t workloadRecords = 100000;
+    size_t workloadOperations = 1000000;
+    size_t workloadInterval = 100000;
+    uint64_t seed = 1;
+    std::string workloadCsvPath = "workload.csv";
+    bool harnessOnly = false;
+    bool help = false;
+};
+
+inline const char* benchmarkUsage() {
+    return "Usage: main [options]\n"
+     "  --structures a,b,...  structures to benchmark, all by default\n"
+     "  --sizes n,m,...       data set sizes\n"
+     "  --datasets i,j,...    data set numbers\n"
+     "  --batch n             operations per timed batch\n"
+     "  --batches n           timed batches per operation\n"
+     "  --warmup n            untimed batches run first\n"
+     "  --cpu n               pin the benchmark to CPU n\n"
+     "  --csv path            CSV results file\n"
+     "  --json path           JSON results file\n"
+     "  --workloads a,b,...   mixed workloads to run, all by default\n"
+     "  --records n           records loaded before a workload\n"
+     "  --operations n        operations per workload\n"
+     "  --interval n          operations per reported workload interval\n"
+     "  --seed n              seed of the workload generator\n"
+     "  --workload-csv path   CSV file of the workload intervals\n"
+     "  --harness-only        skip the comparison sections\n"
+     "  --help                print this text\n";
+}
+
+/*
+    * Split a comma separated list
+    * @param list text to split
+    * @return non-empty items
+*/
+inline std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = std::min(list.find(',', start), list.size());
+        if (end > start)
+            items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+/*
+    * Parse a whole number of an option
+    * @param text number to parse
+    * @param option option the number belongs to, for the error message
+    * @param minimum smallest accepted value
+    * @return parsed number
+    * @throws std::invalid_argument if text is no number of at least minimum
+*/
+inline long parseNumber(const std::string& text, const std::string& option,
+ long minimum) {
+    size_t used = 0;
+    long value = 0;
+    try {
+        value = std::stol(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size() || value < minimum)
+        throw std::invalid_argument(option + " expects a number of at least "
+         + std::to_string(minimum) + ", got '" + text + "'");
+    return value;
+}
+
+/*
+    * Read benchmark settings from the command line
+    * @param argc number of arguments
+    * @param argv arguments, argv[0] being the program
+    * @return settings, defaults for everything not given
+    * @throws std::invalid_argument on an unknown option or a bad value
+*/
+inline BenchmarkOptions parseBenchmarkOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--harness-only") {
+            options.harnessOnly = true;
+            continue;
+        }
+        if (option == "--help" || option == "-h") {
+            options.help = true;
+            continue;
+        }
+        static const char* const valueOptions[] = {"--structures", "--sizes",
+         "--datasets", "--batch", "--batches", "--warmup", "--cpu", "--csv",
+         "--json", "--workloads", "--records", "--operations", "--interval",
+         "--seed", "--workload-csv"};
+        if (std::find(std::begin(valueOptions), std::end(valueOptions),
+         option) == std::end(valueOptions))
+            throw std::invalid_argument("Unknown option " + option);
+        if (i + 1 == argc)
+            throw std::invalid_argument("Missing value for " + option);
+        std::string value = argv[++i];
+        if (option == "--structures") {
+            options.structures = splitList(value);
+        } else if (option == "--sizes" || option == "--datasets") {
+            std::vector<int>& numbers =
+             option == "--sizes" ? options.sizes : options.dataSets;
+            numbers.clear();
+            for (const std::string& item : splitList(value)) {
+                numbers.push_back(static_cast<int>(
+                 parseNumber(item, option, 1)));
+            }
+            if (numbers.empty())
+                throw std::invalid_argument(option + " expects a list");
+        } else if (option == "--batch") {
+            options.batchSize = parseNumber(value, option, 1);
+        } else if (option == "--batches") {
+            options.batches = parseNumber(value, option, 1);
+        } else if (option == "--warmup") {
+            options.warmup = parseNumber(value, option, 0);
+        } else if (option == "--cpu") {
+            options.cpu = static_cast<int>(parseNumber(value, option, 0));
+        } else if (option == "--csv") {
+            options.csvPath = value;
+        } else if (option == "--json") {
+            options.jsonPath = value;
+        } else if (option == "--workloads") {
+            options.workloads = splitList(value);
+        } else if (option == "--records") {
+            options.workloadRecords = parseNumber(value, option, 1);
+        } else if (option == "--operations") {
+            options.workloadOperations = parseNumber(value, option, 1);
+        } else if (option == "--interval") {
+            options.workloadInterval = parseNumber(value, option, 1);
+        } else if (option == "--seed") {
+            options.seed = parseNumber(value, option, 0);
+        } else {
+            options.workloadCsvPath = value;
+        }
+    }
+    return options;
+}
+
+/*
+    * Collects the histograms of a run and writes them out
+*/
+class BenchmarkReport {
+ private:
+    struct Row {
+        std::string structure;
+        std::string operation;
+        int size;
+        int dataSet;
+        size_t operations;  // per batch
+        LatencyHistogram histogram;
+        PerfSample counters;  // all timed batches together
+    };
+
+    std::vector<Row> rows;
+
+    static double ns(uint64_t picoseconds) {
+        return static_cast<double>(picoseconds) / 1000;
+    }
+
+ public:
+    /*
+        * Add the result of one operation on one data set
+        * @param structure structure name
+        * @param operation operation name
+        * @param size data set size
+        * @param dataSet data set number
+        * @param operations operations per batch
+        * @param histogram batch means of the operation
+        * @param counters hardware events of the timed batches
+    */
+    void add(const std::string& structure, const std::string& operation,
+     int size, int dataSet, size_t operations,
+     const LatencyHistogram& histogram,
+     const PerfSample& counters = PerfSample()) {
+        rows.push_back({structure, operation, size, dataSet, operations,
+         histogram, counters});
+    }
+
+    /*
+        * Merge the histograms of every data set of one structure, operation
+        * and size
+        * @param structure structure name
+        * @param operation operation name
+        * @param size data set size
+        * @return merged histogram
+    */
+    LatencyHistogram merged(const std::string& structure,
+     const std::string& operation, int size) const {
+        LatencyHistogram histogram;
+        for (const Row& row : rows) {
+            if (row.structure == structure && row.operation == operation
+             && row.size == size)
+                histogram.merge(row.histogram);
+        }
+        return histogram;
+    }
+
+    /*
+        * Sum the hardware events of every data set of one structure,
+        * operation and size
+        * @param structure structure name
+        * @param operation operation name
+        * @param size data set size
+        * @param operations set to the number of operations counted
+        * @return summed counts
+    */
+    PerfSample mergedCounters(const std::string& structure,
+     const std::string& operation, int size, double& operations) const {
+        PerfSample counters;
+        operations = 0;
+        for (const Row& row : rows) {
+            if (row.structure == structure && row.operation == operation
+             && row.size == size) {
+                addPerfSample(counters, row.counters);
+                operations += static_cast<double>(row.histogram.count())
+                 * row.operations;
+            }
+        }
+        return counters;
+    }
+
+    /*
+        * Write one line per row, times in nanoseconds per operation. The
+        * percentile columns are those of batch means, of single operations
+        * only where opsPerBatch is 1.
+        * @param path file to write
+        * @throws std::runtime_error if the file cannot be written
+    */
+    void writeCsv(const std::string& path) const {
+        std::ofstream output(path);
+        output << "structure;operation;size;dataSet;batches;opsPerBatch;"
+         "minBatchNs;medianBatchNs;p99BatchNs;p999BatchNs;maxBatchNs;meanNs"
+         << perfCsvHeader() << "\n";
+        for (const Row& row : rows) {
+            const LatencyHistogram& h = row.histogram;
+            output << row.structure << ";" << row.operation << ";"
+             << row.size << ";" << row.dataSet << ";" << h.count() << ";"
+             << row.operations << ";" << ns(h.min()) << ";"
+             << ns(h.percentile(0.5)) << ";" << ns(h.percentile(0.99)) << ";"
+             << ns(h.percentile(0.999)) << ";" << ns(h.max()) << ";"
+             << h.mean() / 1000
+             << perfCsvColumns(row.counters,
+              static_cast<double>(h.count()) * row.operations) << "\n";
+        }
+        if (!output)
+            throw std::runtime_error("Cannot write " + path);
+    }
+
+    /*
+        * Write the rows as a JSON array, each with its non-empty histogram
+        * buckets of batch means as [highest ns, count] pairs
+        * @param path file to write
+        * @throws std::runtime_error if the file cannot be written
+    */
+    void writeJson(const std::string& path) const {
+        std::ofstream output(path);
+        output << "[\n";
+        for (size_t r = 0; r < rows.size(); ++r) {
+            const Row& row = rows[r];
+            const LatencyHistogram& h = row.histogram;
+            output << "  {\"structure\": \"" << row.structure
+             << "\", \"operation\": \"" << row.operation
+             << "\", \"size\": " << row.size
+             << ", \"dataSet\": " << row.dataSet
+             << ", \"batches\": " << h.count()
+             << ", \"opsPerBatch\": " << row.operations
+             << ", \"minBatchNs\": " << ns(h.min())
+             << ", \"medianBatchNs\": " << ns(h.percentile(0.5))
+             << ", \"p99BatchNs\": " << ns(h.percentile(0.99))
+             << ", \"p999BatchNs\": " << ns(h.percentile(0.999))
+             << ", \"maxBatchNs\": " << ns(h.max())
+             << ", \"meanNs\": " << h.mean() / 1000;
+            if (PERF_COUNTERS_ENABLED) {
+                double operations = static_cast<double>(h.count())
+                 * row.operations;
+                for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                    double perOperation = row.counters.counts[i] / operations;
+                    output << ", \"" << PERF_EVENT_NAMES[i] << "\": ";
+                    if (std::isfinite(perOperation))
+                        output << perOperation;
+                    else
+                        output << "null";
+                }
+            }
+            output << ", \"histogram\": [";
+            bool first = true;
+            h.forEachBucket([&](uint64_t value, uint64_t count) {
+                output << (first ? "" : ", ") << "[" << ns(value) << ", "
+                 << count << "]";
+                first = false;
+            });
+            output << "]}" << (r + 1 < rows.size() ? "," : "") << "\n";
+        }
+        output << "]\n";
+        if (!output)
+            throw std::runtime_error("Cannot write " + path);
+    }
+};
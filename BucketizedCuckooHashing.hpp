@@ -0,0 +1,481 @@
+#pragma once
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+
+/*
+    * Cuckoo hashing with SLOTS keys per bucket: every key may live in any
+    * slot of two candidate buckets. Keys of a bucket are stored together
+    * (16 bytes for int keys, a quarter of a cache line) and values live in a
+    * separate array, so a lookup reads at most two key buckets. Free
+    * slots hold EMPTY_KEY, -1, which therefore cannot be stored: inserting
+    * it throws and lookups never find it.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class BucketizedCuckooHashing : public HashTable<K, V> {
+ private:
+    static constexpr size_t SLOTS = 4;
+    static constexpr K EMPTY_KEY = -1;
+    static constexpr size_t MAX_SEARCH_NODES = 512;  // BFS bound per insert
+
+    struct alignas(16) Bucket {
+        K keys[SLOTS];
+    };
+
+    // Node of the breadth-first search for an eviction path: the key in
+    // `slot` of the parent's bucket can move into `bucket`
+    struct PathNode {
+        size_t bucket;
+        int parent;
+        size_t slot;
+    };
+
+    Bucket* buckets;
+    V* slotValues;  // SLOTS values per bucket
+    size_t bucketCount;  // power of two
+    size_t size_;
+    Hash hasher;
+    // Keys moved by each insert, and by all of them together
+    std::vector<size_t> displacementHistogram;
+    size_t evictionCount;
+    size_t rehashCount;
+
+    /*
+    * First candidate bucket
+    * @param: K key
+    * @return: size_t
+    */
+    size_t bucket1(const K& key) const {
+        return hasher(key) & (bucketCount - 1);
+    }
+
+    /*
+    * Second candidate bucket
+    * @param: K key
+    * @return: size_t
+    */
+    size_t bucket2(const K& key) const {
+        return remixHash(hasher(key)) & (bucketCount - 1);
+    }
+
+    /*
+    * Candidate bucket of key other than given one
+    * @param: K key
+    * @param: size_t bucket one of the key's buckets
+    * @return: size_t
+    */
+    size_t alternateBucket(const K& key, size_t bucket) const {
+        size_t first = bucket1(key);
+        return first == bucket ? bucket2(key) : first;
+    }
+
+    /*
+    * Find slots of bucket holding given key, one SSE2 compare for
+    * 32-bit integer keys
+    * @param: size_t bucket
+    * @param: K key
+    * @return: uint32_t bitmask of matching slots
+    */
+    uint32_t match(size_t bucket, const K& key) const {
+#if defined(__SSE2__)
+        if constexpr (std::is_integral<K>::value && sizeof(K) == 4) {
+            __m128i keys = _mm_load_si128(
+             reinterpret_cast<const __m128i*>(buckets[bucket].keys));
+            __m128i equal = _mm_cmpeq_epi32(keys,
+             _mm_set1_epi32(static_cast<int>(key)));
+            return _mm_movemask_ps(_mm_castsi128_ps(equal));
+        }
+#endif
+        uint32_t mask = 0;
+        for (size_t i = 0; i < SLOTS; ++i) {
+            if (buckets[bucket].keys[i] == key) mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    /*
+    * Find key in its two candidate buckets
+    * @param: K key
+    * @param: size_t& bucket set to the bucket holding key
+    * @return: int slot of key or -1 if not found
+    */
+    int find(const K& key, size_t& bucket) const {
+        if (key == EMPTY_KEY)
+            return -1;
+        bucket = bucket1(key);
+        uint32_t m = match(bucket, key);
+        if (!m) {
+            bucket = bucket2(key);
+            m = match(bucket, key);
+        }
+        return m ? __builtin_ctz(m) : -1;
+    }
+
+    /*
+    * Find free slot of a bucket
+    * @param: size_t bucket
+    * @return: int free slot or -1 if bucket is full
+    */
+    int freeSlot(size_t bucket) const {
+        uint32_t m = match(bucket, EMPTY_KEY);
+        return m ? __builtin_ctz(m) : -1;
+    }
+
+    /*
+    * Move entry between slots
+    * @param: size_t fromBucket, size_t fromSlot source
+    * @param: size_t toBucket, size_t toSlot destination
+    */
+    void moveEntry(size_t fromBucket, size_t fromSlot,
+     size_t toBucket, size_t toSlot) {
+        buckets[toBucket].keys[toSlot] = buckets[fromBucket].keys[fromSlot];
+        slotValues[toBucket * SLOTS + toSlot] =
+         std::move(slotValues[fromBucket * SLOTS + fromSlot]);
+        buckets[fromBucket].keys[fromSlot] = EMPTY_KEY;
+    }
+
+    /*
+    * Free a slot in one of the candidate buckets of a key by moving other
+    * keys along the shortest eviction path, found breadth-first.
+    * Every move is checked before it happens, so the table stays valid
+    * even if the path crosses itself.
+    * @param: K key key that needs a slot
+    * @param: size_t& bucket set to the bucket with the freed slot
+    * @param: size_t& displaced increased by the number of keys moved
+    * @return: int freed slot or -1 if no path was found
+    */
+    int makeRoom(const K& key, size_t& bucket, size_t& displaced) {
+        std::vector<PathNode> nodes;
+        nodes.push_back({bucket1(key), -1, 0});
+        nodes.push_back({bucket2(key), -1, 0});
+        for (size_t i = 0; i < nodes.size()
+         && nodes.size() < MAX_SEARCH_NODES; ++i) {
+            size_t from = nodes[i].bucket;
+            for (size_t slot = 0; slot < SLOTS; ++slot) {
+                size_t to = alternateBucket(buckets[from].keys[slot], from);
+                nodes.push_back({to, static_cast<int>(i), slot});
+                int free = freeSlot(to);
+                if (free >= 0)
+                    return shiftPath(nodes, nodes.size() - 1, free, bucket,
+                     displaced);
+            }
+        }
+        return -1;
+    }
+
+    /*
+    * Move keys along an eviction path, starting from its free end
+    * @param: nodes search tree
+    * @param: size_t last node whose bucket has a free slot
+    * @param: int free that free slot
+    * @param: size_t& bucket set to the root bucket with the freed slot
+    * @param: size_t& displaced increased by the number of keys moved
+    * @return: int freed slot or -1 if the path became invalid
+    */
+    int shiftPath(const std::vector<PathNode>& nodes, size_t last, int free,
+     size_t& bucket, size_t& displaced) {
+        size_t to = nodes[last].bucket;
+        size_t toSlot = free;
+        int node = static_cast<int>(last);
+        while (nodes[node].parent >= 0) {
+            size_t from = nodes[nodes[node].parent].bucket;
+            size_t fromSlot = nodes[node].slot;
+            const K& moved = buckets[from].keys[fromSlot];
+            if (buckets[to].keys[toSlot] != EMPTY_KEY || moved == EMPTY_KEY
+             || alternateBucket(moved, from) != to) {
+                return -1;
+            }
+            moveEntry(from, fromSlot, to, toSlot);
+            ++displaced;
+            to = from;
+            toSlot = fromSlot;
+            node = nodes[node].parent;
+        }
+        bucket = to;
+        return static_cast<int>(toSlot);
+    }
+
+    /*
+    * Place key known to be absent, growing the table when needed
+    * @param: K key
+    * @param: V value
+    * @return: size_t number of stored keys moved to make room
+    */
+    size_t place(const K& key, const V& value) {
+        size_t bucket;
+        int slot;
+        size_t displaced = 0;
+        for (;;) {
+            bucket = bucket1(key);
+            slot = freeSlot(bucket);
+            if (slot < 0) {
+                bucket = bucket2(key);
+                slot = freeSlot(bucket);
+            }
+            if (slot < 0)
+                slot = makeRoom(key, bucket, displaced);
+            if (slot >= 0)
+                break;
+            rehash(bucketCount * 2);
+        }
+        buckets[bucket].keys[slot] = key;
+        slotValues[bucket * SLOTS + slot] = value;
+        return displaced;
+    }
+
+    /*
+    * Allocate empty arrays
+    * @param: size_t count number of buckets
+    */
+    void allocate(size_t count) {
+        bucketCount = count;
+        buckets = new Bucket[bucketCount];
+        slotValues = new V[bucketCount * SLOTS];
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                buckets[i].keys[j] = EMPTY_KEY;
+            }
+        }
+    }
+
+    /*
+    * Move every entry into a table with more buckets
+    * @param: size_t count new number of buckets
+    */
+    void rehash(size_t count) {
+        Bucket* oldBuckets = buckets;
+        V* oldValues = slotValues;
+        size_t oldCount = bucketCount;
+        allocate(count);
+        ++rehashCount;
+        for (size_t i = 0; i < oldCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                if (oldBuckets[i].keys[j] != EMPTY_KEY) {
+                    place(oldBuckets[i].keys[j], oldValues[i * SLOTS + j]);
+                }
+            }
+        }
+        delete[] oldBuckets;
+        delete[] oldValues;
+    }
+
+ public:
+    /*
+    * Constructor
+    * @param: size_t slotCount number of slots, rounded up so that the
+    * number of buckets is a power of two
+    */
+    explicit BucketizedCuckooHashing(size_t slotCount = 101)
+        : size_(0), evictionCount(0), rehashCount(0) {
+        allocate(roundUpToPowerOfTwo((slotCount + SLOTS - 1) / SLOTS));
+    }
+
+    /*
+    * Copy constructor
+    * @param: BucketizedCuckooHashing object to copy
+    */
+    BucketizedCuckooHashing(const BucketizedCuckooHashing& other)
+        : displacementHistogram(other.displacementHistogram),
+          evictionCount(other.evictionCount),
+          rehashCount(other.rehashCount) {
+        size_ = other.size_;
+        allocate(other.bucketCount);
+        for (size_t i = 0; i < bucketCount; ++i) {
+            buckets[i] = other.buckets[i];
+        }
+        for (size_t i = 0; i < bucketCount * SLOTS; ++i) {
+            slotValues[i] = other.slotValues[i];
+        }
+    }
+
+    /*
+    * Return load factor of the hash table
+    * @return float
+    */
+    float getLoadFactor() override {
+        return static_cast<float>(size_) / (bucketCount * SLOTS);
+    }
+
+    /*
+    * Gather statistics: keys per bucket, and the keys moved by the
+    * inserts since construction
+    * @return: TableStats
+    */
+    TableStats stats() override {
+        TableStats stats;
+        stats.elements = size_;
+        stats.capacity = bucketCount * SLOTS;
+        stats.loadFactor = getLoadFactor();
+        stats.bytesUsed = bucketCount * (sizeof(Bucket) + SLOTS * sizeof(V));
+        for (size_t i = 0; i < bucketCount; ++i) {
+            countInHistogram(stats.bucketOccupancy,
+             SLOTS - __builtin_popcount(match(i, EMPTY_KEY)));
+        }
+        stats.displacementChains = displacementHistogram;
+        stats.evictions = evictionCount;
+        stats.rehashes = rehashCount;
+        return stats;
+    }
+
+    /*
+    * Insert key-value pair, replacing the value of an existing key
+    * @param: K key
+    * @param: V value
+    * @throws: std::invalid_argument if key is EMPTY_KEY
+    */
+    void insert(const K& key, const V& value) override {
+        if (key == EMPTY_KEY)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        size_t bucket;
+        int slot = find(key, bucket);
+        if (slot >= 0) {
+            slotValues[bucket * SLOTS + slot] = value;
+            return;
+        }
+        size_t displaced = place(key, value);
+        countInHistogram(displacementHistogram, displaced);
+        evictionCount += displaced;
+        ++size_;
+    }
+
+    /*
+    * Insert many key-value pairs at once. The table grows once to have a
+    * slot for each of them, then the pairs are inserted one by one:
+    * eviction paths may cross the whole table, so it cannot be split into
+    * independent parts. Like insert, it grows again only when no eviction
+    * path is found.
+    * @param: const K* keys keys to insert
+    * @param: const V* values values to insert, values[i] belongs to keys[i]
+    * @param: size_t count number of pairs
+    * @throws: std::invalid_argument if a key is EMPTY_KEY, before any
+    * pair is inserted
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        if (std::find(keys, keys + count, EMPTY_KEY) != keys + count)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        size_t newCount = bucketCount;
+        while (size_ + count > newCount * SLOTS) {
+            newCount *= 2;
+        }
+        if (newCount != bucketCount)
+            rehash(newCount);
+        for (size_t i = 0; i < count; ++i) {
+            insert(keys[i], values[i]);
+        }
+    }
+
+    /*
+    * Search for key
+    * @param: K key
+    * @return: V
+    * @throws: std::out_of_range if key not found
+    */
+    V search(const K& key) override {
+        size_t bucket;
+        int slot = find(key, bucket);
+        if (slot < 0) {
+            throw std::out_of_range("Key not found");
+        }
+        return slotValues[bucket * SLOTS + slot];
+    }
+
+    /*
+    * Remove key from hash table
+    * @param: K key
+    * @throws: std::out_of_range if key not found
+    */
+    void remove(const K& key) override {
+        size_t bucket;
+        int slot = find(key, bucket);
+        if (slot < 0) {
+            throw std::out_of_range("Key not found");
+        }
+        buckets[bucket].keys[slot] = EMPTY_KEY;
+        slotValues[bucket * SLOTS + slot] = V();
+        --size_;
+    }
+
+    /*
+    * Check if key exists in hash table
+    * @param: K key
+    * @return: bool
+    */
+    bool exists(const K& key) override {
+        size_t bucket;
+        return find(key, bucket) >= 0;
+    }
+
+    /*
+    * Return size of hash table
+    * @return: size_t
+    */
+    size_t size() override {
+        return size_;
+    }
+
+    /*
+    * Check if hash table is empty
+    * @return: bool
+    */
+    bool empty() override {
+        return size_ == 0;
+    }
+
+    /*
+    * Print all keys in hash table
+    */
+    void keys() override {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                if (buckets[i].keys[j] != EMPTY_KEY) {
+                    std::cout << buckets[i].keys[j] << " ";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    /*
+    * Print all values in hash table
+    */
+    void values() override {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                if (buckets[i].keys[j] != EMPTY_KEY) {
+                    std::cout << slotValues[i * SLOTS + j] << " ";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    /*
+    * Print hash table
+    */
+    void print() override {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            std::cout << "Bucket " << i << ":";
+            for (size_t j = 0; j < SLOTS; ++j) {
+                std::cout << " (" << buckets[i].keys[j] << ", "
+                 << slotValues[i * SLOTS + j] << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    /*
+    * Destructor
+    */
+    ~BucketizedCuckooHashing() override {
+        delete[] buckets;
+        delete[] slotValues;
+    }
+};
@@ -1,14 +1,52 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 #include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
 #include "./BST.hpp"
+#include "./NodePool.hpp"
+#include "./ParallelBuild.hpp"
+#include "./Snapshot.hpp"
 
-template <typename K, typename V>
+/*
+    * Separate chaining where a bucket keeps up to INLINE_SLOTS entries,
+    * keys and values, in place and only turns into an AVL tree when it
+    * overflows, the way Java's HashMap treeifies long chains. At the usual
+    * load factor almost every bucket stays inline, so a lookup reads the
+    * bucket alone and the table allocates no node for it, while crowded
+    * buckets keep their O(log n) bound.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
 class ClosedAddressingWithBST : public HashTable<K, V> {
  private:
-    BST<K, V>** table;
-    size_t tableSize;
+    static constexpr size_t INLINE_SLOTS = 2;
+    // A tree bucket goes back to inline storage once it shrinks to this
+    // size; staying below INLINE_SLOTS keeps a bucket from flipping on
+    // every insert and remove at the boundary
+    static constexpr size_t DEMOTE_THRESHOLD = 1;
+    static constexpr size_t BATCH_SIZE = 16;  // lookups in flight per batch
+
+    struct Bucket {
+        K keys[INLINE_SLOTS];
+        uint32_t count;  // entries in the bucket, inline or in the tree
+        BST<K, V> tree;  // empty unless the bucket was promoted
+        V values[INLINE_SLOTS];  // default values once promoted
+
+        Bucket() : keys(), count(0), values() {}
+    };
+
+    Bucket* table;
+    // Entries of promoted buckets live in nodes of this pool, so tearing
+    // the table down frees a few slabs instead of every node
+    NodePool<K, V> pool;
+    size_t tableSize;  // power of two
     size_t numElements;
+    Hash hasher;
 
     /*
         * Hash function
@@ -16,34 +54,230 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
         * @return hashed key
     */
     size_t hash(const K& key) const {
-        return key % tableSize;
+        return hasher(key) & (tableSize - 1);
+    }
+
+    /*
+        * Find key among the inline entries of a bucket
+        * @param bucket bucket to search
+        * @param key key to search for
+        * @return slot of key or -1 if not found
+    */
+    static int findInline(const Bucket& bucket, const K& key) {
+        for (uint32_t i = 0; i < bucket.count; ++i) {
+            if (bucket.keys[i] == key)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    /*
+        * Hash a batch of keys and prefetch the bucket of each one
+        * @param keys keys of the batch
+        * @param count number of keys, at most BATCH_SIZE
+        * @param buckets set to the bucket index of each key
+    */
+    void prefetchBatch(const K* keys, size_t count, size_t* buckets) const {
+        for (size_t i = 0; i < count; ++i) {
+            buckets[i] = hash(keys[i]);
+            __builtin_prefetch(&table[buckets[i]]);
+        }
+    }
+
+    /*
+        * Find value of key in its bucket, inline or in a tree node
+        * @param bucket bucket of the key
+        * @param key key to search for
+        * @return value or nullptr if key not found
+    */
+    V* findValue(Bucket& bucket, const K& key) {
+        if (!bucket.tree.empty()) {
+            uint32_t node = bucket.tree.find(pool, key);
+            return node != NodePool<K, V>::NIL ? &pool[node].value : nullptr;
+        }
+        int slot = findInline(bucket, key);
+        return slot >= 0 ? &bucket.values[slot] : nullptr;
+    }
+
+    /*
+        * Move the inline entries of a full bucket into tree nodes
+        * @param bucket bucket to promote
+        * @param allocate function returning a fresh leaf node holding the
+        * given key and a default value
+    */
+    template <typename Allocate>
+    void promote(Bucket& bucket, Allocate allocate) {
+        for (uint32_t i = 0; i < bucket.count; ++i) {
+            uint32_t node = allocate(bucket.keys[i]);
+            std::swap(pool[node].value, bucket.values[i]);
+            bucket.tree.insertNode(pool, node);
+        }
+    }
+
+    /*
+        * Move the entries of a shrunken tree back inline, releasing their
+        * nodes
+        * @param bucket bucket to demote
+    */
+    void demote(Bucket& bucket) {
+        uint32_t nodes[INLINE_SLOTS];
+        size_t count = bucket.tree.detach(pool, bucket.keys, nodes);
+        for (size_t i = 0; i < count; ++i) {
+            std::swap(bucket.values[i], pool[nodes[i]].value);
+            pool.release(nodes[i]);
+        }
     }
 
  public:
     /*
         * Constructor
-        * @param size size of hash table
+        * @param size size of hash table, rounded up to a power of two
     */
     explicit ClosedAddressingWithBST(size_t size = 101)
-        : tableSize(size), numElements(0) {
-        table = new BST<K, V>*[tableSize];
+        : tableSize(roundUpToPowerOfTwo(size)), numElements(0) {
+        table = new Bucket[tableSize];
+    }
+
+    /*
+        * Copy constructor
+        * @param other ClosedAddressingWithBST object to copy
+    */
+    ClosedAddressingWithBST(const ClosedAddressingWithBST& other)
+        : pool(other.pool), tableSize(other.tableSize),
+          numElements(other.numElements) {
+        table = new Bucket[tableSize];
         for (size_t i = 0; i < tableSize; ++i) {
-            table[i] = nullptr;
+            table[i] = other.table[i];
         }
     }
 
     /*
-        * Insert key-value pair
+        * Insert key-value pair, replacing the value of an existing key
         * @param key key to insert
         * @param value value to insert
     */
     void insert(const K& key, const V& value) override {
-        size_t index = hash(key);
-        if (!table[index]) {
-            table[index] = new BST<K, V>();
+        Bucket& bucket = table[hash(key)];
+        if (bucket.tree.empty()) {
+            int slot = findInline(bucket, key);
+            if (slot >= 0) {
+                bucket.values[slot] = value;
+                return;
+            }
+            if (bucket.count < INLINE_SLOTS) {
+                bucket.keys[bucket.count] = key;
+                bucket.values[bucket.count] = value;
+                ++bucket.count;
+                ++numElements;
+                return;
+            }
+            promote(bucket, [&](const K& inlineKey) {
+                return pool.allocate(inlineKey, V());
+            });
+        }
+        if (bucket.tree.insert(pool, key, value)) {
+            ++bucket.count;
+            ++numElements;
+        }
+    }
+
+    /*
+        * Insert many key-value pairs at once. An empty table first grows
+        * to one bucket per pair. Pairs are then grouped by ranges of
+        * buckets and the ranges are filled in parallel: a first pass fills
+        * inline slots and counts the tree nodes the rest of each range
+        * needs, nodes for all ranges are reserved at once, and a second
+        * pass builds the trees, so no thread allocates from the pool.
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        if (numElements == 0 && count > tableSize) {
+            delete[] table;
+            tableSize = roundUpToPowerOfTwo(count);
+            table = new Bucket[tableSize];
+            pool.clear();
+        }
+        unsigned threads = buildThreadCount(count);
+        size_t parts = buildPartCount(threads, tableSize);
+        size_t bucketsPerPart = tableSize / parts;
+        std::vector<size_t> order;
+        std::vector<size_t> offsets = partitionEntries(count, parts, threads,
+         [&](size_t i) { return hash(keys[i]) / bucketsPerPart; }, order);
+        std::vector<size_t> added(parts, 0);
+        // Pairs left for the trees, and the nodes they need: one each and
+        // one per inline entry of a bucket they promote
+        std::vector<std::vector<size_t>> deferred(parts);
+        std::vector<size_t> needed(parts, 0);
+        parallelFor(parts, threads, [&](size_t part) {
+            std::vector<bool> promoted(bucketsPerPart, false);
+            for (size_t j = offsets[part]; j < offsets[part + 1]; ++j) {
+                size_t index = hash(keys[order[j]]);
+                Bucket& bucket = table[index];
+                V* existing = findValue(bucket, keys[order[j]]);
+                if (existing) {
+                    *existing = values[order[j]];
+                } else if (bucket.tree.empty()
+                 && bucket.count < INLINE_SLOTS) {
+                    bucket.keys[bucket.count] = keys[order[j]];
+                    bucket.values[bucket.count] = values[order[j]];
+                    ++bucket.count;
+                    ++added[part];
+                } else {
+                    deferred[part].push_back(order[j]);
+                    ++needed[part];
+                    size_t local = index - part * bucketsPerPart;
+                    if (bucket.tree.empty() && !promoted[local]) {
+                        promoted[local] = true;
+                        needed[part] += bucket.count;
+                    }
+                }
+            }
+        });
+        std::vector<uint32_t> firstNodes(parts);
+        size_t reserved = 0;
+        for (size_t part = 0; part < parts; ++part) {
+            reserved += needed[part];
+        }
+        uint32_t next = pool.reserve(reserved);
+        for (size_t part = 0; part < parts; ++part) {
+            firstNodes[part] = next;
+            next += static_cast<uint32_t>(needed[part]);
+        }
+        std::vector<std::vector<uint32_t>> unused(parts);
+        parallelFor(parts, threads, [&](size_t part) {
+            uint32_t node = firstNodes[part];
+            uint32_t last = node + static_cast<uint32_t>(needed[part]);
+            auto allocate = [&](const K& key) {
+                pool.construct(node, key, V());
+                return node++;
+            };
+            for (size_t i : deferred[part]) {
+                Bucket& bucket = table[hash(keys[i])];
+                V* existing = findValue(bucket, keys[i]);
+                if (existing) {
+                    *existing = values[i];
+                    continue;
+                }
+                if (bucket.tree.empty())
+                    promote(bucket, allocate);
+                uint32_t leaf = allocate(keys[i]);
+                pool[leaf].value = values[i];
+                bucket.tree.insertNode(pool, leaf);
+                ++bucket.count;
+                ++added[part];
+            }
+            for (; node < last; ++node) {
+                unused[part].push_back(node);
+            }
+        });
+        for (size_t part = 0; part < parts; ++part) {
+            numElements += added[part];
+            for (uint32_t node : unused[part]) {
+                pool.release(node);
+            }
         }
-        table[index]->insert(key, value);
-        ++numElements;
     }
 
     /*
@@ -53,11 +287,15 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
         * @throws std::out_of_range if key not found
     */
     V search(const K& key) override {
-        size_t index = hash(key);
-        if (!table[index]) {
+        const Bucket& bucket = table[hash(key)];
+        if (!bucket.tree.empty()) {
+            return bucket.tree.search(pool, key);
+        }
+        int slot = findInline(bucket, key);
+        if (slot < 0) {
             throw std::out_of_range("Key not found");
         }
-        return table[index]->search(key);
+        return bucket.values[slot];
     }
 
     /*
@@ -65,11 +303,27 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
         * @param key key to remove
     */
     void remove(const K& key) override {
-        size_t index = hash(key);
-        if (table[index]) {
-            table[index]->remove(key);
-            --numElements;
+        Bucket& bucket = table[hash(key)];
+        if (!bucket.tree.empty()) {
+            if (bucket.tree.remove(pool, key)) {
+                --numElements;
+                if (--bucket.count <= DEMOTE_THRESHOLD) {
+                    demote(bucket);
+                }
+            }
+            return;
+        }
+        int slot = findInline(bucket, key);
+        if (slot < 0) {
+            return;
+        }
+        uint32_t last = --bucket.count;
+        if (static_cast<uint32_t>(slot) != last) {
+            bucket.keys[slot] = bucket.keys[last];
+            bucket.values[slot] = std::move(bucket.values[last]);
         }
+        bucket.values[last] = V();  // drop resources held by the value early
+        --numElements;
     }
 
     /*
@@ -78,8 +332,140 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
         * @return true if key exists, false otherwise
     */
     bool exists(const K& key) override {
-        size_t index = hash(key);
-        return table[index] && table[index]->exists(key);
+        const Bucket& bucket = table[hash(key)];
+        if (!bucket.tree.empty()) {
+            return bucket.tree.exists(pool, key);
+        }
+        return findInline(bucket, key) >= 0;
+    }
+
+    /*
+        * Check many keys at once, prefetching the bucket of every key of a
+        * batch before comparing any keys
+        * @param keys keys to check
+        * @param count number of keys
+        * @param results set to whether each key exists
+    */
+    void existsBatch(const K* keys, size_t count, bool* results) override {
+        size_t buckets[BATCH_SIZE];
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            prefetchBatch(keys + base, n, buckets);
+            for (size_t i = 0; i < n; ++i) {
+                const Bucket& bucket = table[buckets[i]];
+                results[base + i] = bucket.tree.empty()
+                 ? findInline(bucket, keys[base + i]) >= 0
+                 : bucket.tree.exists(pool, keys[base + i]);
+            }
+        }
+    }
+
+    /*
+        * Search for many keys at once in two prefetched passes: buckets
+        * of the whole batch first, then the values, inline or in tree
+        * nodes
+        * @param keys keys to search for
+        * @param count number of keys
+        * @param values set to the value of each key that was found
+        * @param found set to whether each key was found
+        * @return number of keys found
+    */
+    size_t searchBatch(const K* keys, size_t count,
+     V* values, bool* found) override {
+        size_t buckets[BATCH_SIZE];
+        const V* hits[BATCH_SIZE];
+        size_t hitCount = 0;
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            prefetchBatch(keys + base, n, buckets);
+            for (size_t i = 0; i < n; ++i) {
+                hits[i] = findValue(table[buckets[i]], keys[base + i]);
+                if (hits[i])
+                    __builtin_prefetch(hits[i]);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                found[base + i] = hits[i] != nullptr;
+                if (hits[i]) {
+                    values[base + i] = *hits[i];
+                    ++hitCount;
+                }
+            }
+        }
+        return hitCount;
+    }
+
+    /*
+        * Gather statistics of the buckets: how many keys each holds and
+        * how tall the trees of promoted buckets have grown
+        * @return statistics
+    */
+    TableStats stats() override {
+        TableStats stats;
+        stats.elements = numElements;
+        stats.capacity = tableSize;
+        stats.loadFactor = getLoadFactor();
+        stats.bytesUsed = tableSize * sizeof(Bucket) + pool.bytes();
+        for (size_t i = 0; i < tableSize; ++i) {
+            countInHistogram(stats.bucketOccupancy, table[i].count);
+            countInHistogram(stats.treeHeights,
+             static_cast<size_t>(table[i].tree.height(pool)));
+        }
+        return stats;
+    }
+
+    /*
+        * Write every entry to a snapshot image, bucket by bucket. Trees
+        * cannot be searched in a mapping, so the image only lists the
+        * entries and load() rebuilds the table from them.
+        * @param path file to write
+        * @throws std::runtime_error if the file cannot be written
+    */
+    void save(const std::string& path) {
+        std::vector<std::pair<const K*, const V*>> entries;
+        entries.reserve(numElements);
+        for (size_t i = 0; i < tableSize; ++i) {
+            for (uint32_t j = 0; table[i].tree.empty()
+             && j < table[i].count; ++j) {
+                entries.push_back({&table[i].keys[j], &table[i].values[j]});
+            }
+            table[i].tree.inorder(pool, [&](BSTNode<K, V>* node) {
+                entries.push_back({&node->key, &node->value});
+            });
+        }
+        SnapshotHeader header = {};
+        header.kind = SnapshotKind::ClosedAddressing;
+        header.hashCheck = hasher(snapshotHashCheckKey<K>());
+        header.arrayCount = 1;
+        header.slotCount = numElements;
+        header.elementCount = numElements;
+        header.params[0] = tableSize;
+        writeSnapshot<K, V>(path, header,
+         [&](size_t i) { return *entries[i].first; },
+         [&](size_t i) -> const V& { return *entries[i].second; },
+         [](size_t) { return SlotState::Full; });
+    }
+
+    /*
+        * Replace the contents of the table with a snapshot image, rebuilt
+        * with bulkLoad()
+        * @param path image written by save()
+        * @throws std::runtime_error if the file is not an image of this
+        * table type
+    */
+    void load(const std::string& path) {
+        SnapshotImage<K, V> image(path, SnapshotKind::ClosedAddressing,
+         hasher(snapshotHashCheckKey<K>()), MappedAccess::Sequential);
+        size_t count = image.header().slotCount;
+        std::vector<V> values(count);
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = image.value(i);
+        }
+        delete[] table;
+        tableSize = image.header().params[0];
+        table = new Bucket[tableSize];
+        pool.clear();
+        numElements = 0;
+        bulkLoad(image.keys(), values.data(), count);
     }
 
     /*
@@ -103,11 +489,13 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
     */
     void keys() override {
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table[i]) {
-                table[i]->inorder([](BSTNode<K, V>* node) {
-                    std::cout << node->key << " ";
-                });
+            for (uint32_t j = 0; table[i].tree.empty()
+             && j < table[i].count; ++j) {
+                std::cout << table[i].keys[j] << " ";
             }
+            table[i].tree.inorder(pool, [](BSTNode<K, V>* node) {
+                std::cout << node->key << " ";
+            });
         }
         std::cout << std::endl;
     }
@@ -117,11 +505,13 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
     */
     void values() override {
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table[i]) {
-                table[i]->inorder([](BSTNode<K, V>* node) {
-                    std::cout << node->value << " ";
-                });
+            for (uint32_t j = 0; table[i].tree.empty()
+             && j < table[i].count; ++j) {
+                std::cout << table[i].values[j] << " ";
             }
+            table[i].tree.inorder(pool, [](BSTNode<K, V>* node) {
+                std::cout << node->value << " ";
+            });
         }
         std::cout << std::endl;
     }
@@ -132,12 +522,15 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
     void print() override {
         for (size_t i = 0; i < tableSize; ++i) {
             std::cout << "Bucket " << i << ": ";
-            if (table[i]) {
-                table[i]->inorder([](BSTNode<K, V>* node) {
-                    std::cout << "(" << node->key <<
-                     ", " << node->value << ") ";
-                });
+            for (uint32_t j = 0; table[i].tree.empty()
+             && j < table[i].count; ++j) {
+                std::cout << "(" << table[i].keys[j] << ", "
+                 << table[i].values[j] << ") ";
             }
+            table[i].tree.inorder(pool, [](BSTNode<K, V>* node) {
+                std::cout << "(" << node->key <<
+                 ", " << node->value << ") ";
+            });
             std::cout << std::endl;
         }
     }
@@ -155,9 +548,6 @@ class ClosedAddressingWithBST : public HashTable<K, V> {
         * Destructor
     */
     ~ClosedAddressingWithBST() {
-        for (size_t i = 0; i < tableSize; ++i) {
-            delete table[i];
-        }
         delete[] table;
     }
 };
@@ -0,0 +1,237 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+#include "./ClosedAddressingWithBST.hpp"
+#include "./ParallelBuild.hpp"
+
+/*
+    * Closed addressing that many threads can use at once. The buckets are
+    * split into stripes, each a ClosedAddressingWithBST guarded by its own
+    * reader-writer lock, so lookups only wait for writers of the same
+    * stripe and never for other readers. Every stripe also owns its node
+    * pool, so writers of different stripes never share an allocator.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class ConcurrentClosedAddressingWithBST : public HashTable<K, V> {
+ private:
+    // Own cache line per stripe, so locking one stripe does not slow
+    // down threads working on its neighbours
+    struct alignas(64) Stripe {
+        std::shared_mutex lock;
+        ClosedAddressingWithBST<K, V, Hash>* buckets;
+        std::atomic<size_t> count;  // written under `lock`, read relaxed
+    };
+
+    Stripe* stripes;
+    size_t stripeCount;  // power of two
+    size_t bucketsPerStripe;
+    Hash hasher;
+
+    /*
+        * Stripe of a key. The bucket inside the stripe comes from the low
+        * bits of the hash, so the stripe is taken from a remix of it.
+        * @param key key to look up
+        * @return stripe holding the key's bucket
+    */
+    Stripe& stripe(const K& key) {
+        return stripes[remixHash(hasher(key)) & (stripeCount - 1)];
+    }
+
+ public:
+    /*
+        * Constructor
+        * @param size total number of buckets, rounded up to a power of two
+        * @param stripeCount number of locks, rounded up to a power of two
+    */
+    explicit ConcurrentClosedAddressingWithBST(size_t size = 101,
+     size_t stripeCount = 64)
+        : stripeCount(roundUpToPowerOfTwo(stripeCount)) {
+        bucketsPerStripe = roundUpToPowerOfTwo(size) / this->stripeCount;
+        if (bucketsPerStripe == 0)
+            bucketsPerStripe = 1;
+        stripes = new Stripe[this->stripeCount];
+        for (size_t i = 0; i < this->stripeCount; ++i) {
+            stripes[i].buckets =
+             new ClosedAddressingWithBST<K, V, Hash>(bucketsPerStripe);
+            stripes[i].count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentClosedAddressingWithBST(
+     const ConcurrentClosedAddressingWithBST&) = delete;
+    ConcurrentClosedAddressingWithBST& operator=(
+     const ConcurrentClosedAddressingWithBST&) = delete;
+
+    /*
+        * Insert key-value pair, replacing the value of an existing key
+        * @param key key to insert
+        * @param value value to insert
+    */
+    void insert(const K& key, const V& value) override {
+        Stripe& s = stripe(key);
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        s.buckets->insert(key, value);
+        s.count.store(s.buckets->size(), std::memory_order_relaxed);
+    }
+
+    /*
+        * Insert many key-value pairs at once. Pairs are grouped by stripe
+        * and every stripe is filled by one thread under a single lock.
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        unsigned threads = buildThreadCount(count);
+        if (threads == 1) {
+            HashTable<K, V>::bulkLoad(keys, values, count);
+            return;
+        }
+        std::vector<size_t> order;
+        std::vector<size_t> offsets = partitionEntries(count, stripeCount,
+         threads, [&](size_t i) { return &stripe(keys[i]) - stripes; },
+         order);
+        parallelFor(stripeCount, threads, [&](size_t i) {
+            Stripe& s = stripes[i];
+            std::unique_lock<std::shared_mutex> guard(s.lock);
+            for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+                s.buckets->insert(keys[order[j]], values[order[j]]);
+            }
+            s.count.store(s.buckets->size(), std::memory_order_relaxed);
+        });
+    }
+
+    /*
+        * Search for key in hash table
+        * @param key key to search for
+        * @return value associated with key
+        * @throws std::out_of_range if key not found
+    */
+    V search(const K& key) override {
+        Stripe& s = stripe(key);
+        std::shared_lock<std::shared_mutex> guard(s.lock);
+        return s.buckets->search(key);
+    }
+
+    /*
+        * Remove key from hash table
+        * @param key key to remove
+    */
+    void remove(const K& key) override {
+        Stripe& s = stripe(key);
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        s.buckets->remove(key);
+        s.count.store(s.buckets->size(), std::memory_order_relaxed);
+    }
+
+    /*
+        * Check if key exists in hash table
+        * @param key key to search for
+        * @return true if key exists, false otherwise
+    */
+    bool exists(const K& key) override {
+        Stripe& s = stripe(key);
+        std::shared_lock<std::shared_mutex> guard(s.lock);
+        return s.buckets->exists(key);
+    }
+
+    /*
+        * Get number of elements in hash table. Stripes are summed without
+        * locking, so with concurrent writers the result is approximate.
+        * @return number of elements
+    */
+    size_t size() override {
+        size_t total = 0;
+        for (size_t i = 0; i < stripeCount; ++i) {
+            total += stripes[i].count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /*
+        * Check if hash table is empty
+        * @return true if hash table is empty, false otherwise
+    */
+    bool empty() override {
+        return size() == 0;
+    }
+
+    /*
+        * Print all keys in hash table
+    */
+    void keys() override {
+        for (size_t i = 0; i < stripeCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(stripes[i].lock);
+            stripes[i].buckets->keys();
+        }
+    }
+
+    /*
+        * Print all values in hash table
+    */
+    void values() override {
+        for (size_t i = 0; i < stripeCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(stripes[i].lock);
+            stripes[i].buckets->values();
+        }
+    }
+
+    /*
+        * Print hash table, stripe by stripe
+    */
+    void print() override {
+        for (size_t i = 0; i < stripeCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(stripes[i].lock);
+            std::cout << "Stripe " << i << ":" << std::endl;
+            stripes[i].buckets->print();
+        }
+    }
+
+    /*
+        * Gather statistics of every stripe, each read under its lock, so
+        * the totals may mix stripes seen before and after a concurrent
+        * write
+        * @return statistics
+    */
+    TableStats stats() override {
+        TableStats stats;
+        for (size_t i = 0; i < stripeCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(stripes[i].lock);
+            TableStats stripeStats = stripes[i].buckets->stats();
+            stats.elements += stripeStats.elements;
+            stats.capacity += stripeStats.capacity;
+            stats.bytesUsed += stripeStats.bytesUsed;
+            mergeHistogram(stats.bucketOccupancy, stripeStats.bucketOccupancy);
+            mergeHistogram(stats.treeHeights, stripeStats.treeHeights);
+        }
+        stats.bytesUsed += stripeCount * sizeof(Stripe);
+        stats.loadFactor = static_cast<float>(stats.elements)
+         / static_cast<float>(stats.capacity);
+        return stats;
+    }
+
+    /*
+        * Get load factor of hash table
+        * @return load factor
+    */
+    float getLoadFactor() override {
+        return static_cast<float>(size())
+         / static_cast<float>(stripeCount * bucketsPerStripe);
+    }
+
+    /*
+        * Destructor
+    */
+    ~ConcurrentClosedAddressingWithBST() {
+        for (size_t i = 0; i < stripeCount; ++i) {
+            delete stripes[i].buckets;
+        }
+        delete[] stripes;
+    }
+};
@@ -0,0 +1,547 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+#include "./ParallelBuild.hpp"
+#include "./EpochReclamation.hpp"
+
+/*
+    * Cuckoo hashing for many concurrent readers and writers, after
+    * libcuckoo. Every key may live in any of the SLOTS slots of its two
+    * candidate buckets. Buckets map onto lock stripes whose counters work
+    * as seqlocks: a writer makes the counter odd while it changes a
+    * bucket, and a reader retries when either of its two counters was odd
+    * or moved during the read, so lookups never take a lock.
+    *
+    * A writer locks both candidate buckets of the key, lower stripe first.
+    * When both are full it searches an eviction path without holding any
+    * lock, then performs the moves from the free end back, each one under
+    * the locks of the two buckets it touches and only after checking that
+    * the path is still valid. A moved key is in one of its own buckets at
+    * all times and both are locked while it moves, so a reader never sees
+    * it missing.
+    *
+    * The number of buckets is fixed at construction. Empty slots hold
+    * EMPTY_KEY, -1, so that key cannot be stored: inserting it throws and
+    * lookups never find it.
+    *
+    * The stripe locks only order writers among themselves. A reader holds
+    * no lock and may still be dereferencing a value when a writer swaps it
+    * out, and its seqlock check only tells it to retry afterwards. Writers
+    * therefore never free a value under the lock: every operation pins an
+    * epoch, and the value a writer replaces or removes is freed through
+    * EpochReclamation.hpp once all readers that could have seen it are
+    * done.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class ConcurrentCuckooHashing : public HashTable<K, V> {
+ private:
+    static_assert(std::atomic<K>::is_always_lock_free,
+     "ConcurrentCuckooHashing needs lock-free atomic keys");
+
+    static constexpr size_t SLOTS = 4;
+    static constexpr K EMPTY_KEY = -1;
+    static constexpr size_t MAX_SEARCH_NODES = 512;  // BFS bound per insert
+    static constexpr size_t MAX_LOCKS = 4096;
+
+    struct Bucket {
+        std::atomic<K> keys[SLOTS];
+        std::atomic<V*> values[SLOTS];
+    };
+
+    // Node of the breadth-first search for an eviction path: the key in
+    // `slot` of the parent's bucket can move into `bucket`
+    struct PathNode {
+        size_t bucket;
+        int parent;
+        size_t slot;
+    };
+
+    Bucket* buckets;
+    size_t bucketCount;  // power of two
+    std::atomic<uint64_t>* locks;  // seqlock per stripe, odd while locked
+    size_t lockCount;  // power of two, at most bucketCount
+    std::atomic<size_t> size_;
+    Hash hasher;
+
+    /*
+        * First candidate bucket
+        * @param key key to hash
+        * @return bucket index
+    */
+    size_t bucket1(const K& key) const {
+        return hasher(key) & (bucketCount - 1);
+    }
+
+    /*
+        * Second candidate bucket
+        * @param key key to hash
+        * @return bucket index
+    */
+    size_t bucket2(const K& key) const {
+        return remixHash(hasher(key)) & (bucketCount - 1);
+    }
+
+    /*
+        * Candidate bucket of key other than given one
+        * @param key key that lives in bucket
+        * @param bucket one of the key's buckets
+        * @return the key's other bucket
+    */
+    size_t alternateBucket(const K& key, size_t bucket) const {
+        size_t first = bucket1(key);
+        return first == bucket ? bucket2(key) : first;
+    }
+
+    /*
+        * Lock stripe of a bucket
+        * @param bucket bucket index
+        * @return stripe index
+    */
+    size_t stripe(size_t bucket) const {
+        return bucket & (lockCount - 1);
+    }
+
+    /*
+        * Take the seqlock of a stripe, making its counter odd
+        * @param stripe stripe index
+    */
+    void lock(size_t stripe) {
+        for (;;) {
+            uint64_t version = locks[stripe].load(std::memory_order_relaxed);
+            if (!(version & 1) && locks[stripe].compare_exchange_weak(
+             version, version + 1, std::memory_order_acquire)) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        // Keep the writes that follow from becoming visible before the
+        // odd counter
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /*
+        * Release the seqlock of a stripe, publishing the writes made under it
+        * @param stripe stripe index
+    */
+    void unlock(size_t stripe) {
+        locks[stripe].fetch_add(1, std::memory_order_release);
+    }
+
+    /*
+        * Lock the stripes of two buckets, lower stripe first
+        * @param first first bucket
+        * @param second second bucket
+    */
+    void lockPair(size_t first, size_t second) {
+        size_t a = stripe(first);
+        size_t b = stripe(second);
+        if (a > b) std::swap(a, b);
+        lock(a);
+        if (b != a) lock(b);
+    }
+
+    /*
+        * Unlock the stripes of two buckets
+        * @param first first bucket
+        * @param second second bucket
+    */
+    void unlockPair(size_t first, size_t second) {
+        size_t a = stripe(first);
+        size_t b = stripe(second);
+        unlock(a);
+        if (b != a) unlock(b);
+    }
+
+    /*
+        * Find slot of bucket holding key
+        * @param bucket bucket to look in
+        * @param key key to look for
+        * @return slot index or -1 if not found
+    */
+    int slotOf(size_t bucket, const K& key) const {
+        for (size_t i = 0; i < SLOTS; ++i) {
+            if (buckets[bucket].keys[i].load(std::memory_order_relaxed)
+             == key) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    /*
+        * Read the value of key optimistically, retrying while a writer holds
+        * either candidate bucket or changed one during the read
+        * @param key key to search for
+        * @return value or nullptr if key not found
+    */
+    V* read(const K& key) const {
+        if (key == EMPTY_KEY)
+            return nullptr;
+        size_t first = bucket1(key);
+        size_t second = bucket2(key);
+        size_t a = stripe(first);
+        size_t b = stripe(second);
+        for (;;) {
+            uint64_t versionA = locks[a].load(std::memory_order_acquire);
+            uint64_t versionB = locks[b].load(std::memory_order_acquire);
+            if ((versionA | versionB) & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            V* value = nullptr;
+            int slot = slotOf(first, key);
+            if (slot >= 0) {
+                value = buckets[first].values[slot]
+                 .load(std::memory_order_relaxed);
+            } else if ((slot = slotOf(second, key)) >= 0) {
+                value = buckets[second].values[slot]
+                 .load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (locks[a].load(std::memory_order_relaxed) == versionA
+             && locks[b].load(std::memory_order_relaxed) == versionB) {
+                return value;
+            }
+        }
+    }
+
+    /*
+        * Find an eviction path that frees a slot in one of the key's buckets.
+        * Runs without locks, so the path may be stale by the time it is used.
+        * @param key key that needs a slot
+        * @param nodes filled with the search tree
+        * @return node whose bucket had a free slot or -1 if none found
+    */
+    int findPath(const K& key, std::vector<PathNode>& nodes) const {
+        nodes.clear();
+        nodes.push_back({bucket1(key), -1, 0});
+        nodes.push_back({bucket2(key), -1, 0});
+        for (size_t i = 0; i < nodes.size()
+         && nodes.size() < MAX_SEARCH_NODES; ++i) {
+            size_t from = nodes[i].bucket;
+            for (size_t slot = 0; slot < SLOTS; ++slot) {
+                K moved = buckets[from].keys[slot]
+                 .load(std::memory_order_relaxed);
+                if (moved == EMPTY_KEY)
+                    return static_cast<int>(i);
+                nodes.push_back({alternateBucket(moved, from),
+                 static_cast<int>(i), slot});
+                if (slotOf(nodes.back().bucket, EMPTY_KEY) >= 0)
+                    return static_cast<int>(nodes.size() - 1);
+            }
+        }
+        return -1;
+    }
+
+    /*
+        * Move one key into the free slot of its other bucket, under the locks
+        * of both buckets
+        * @param from bucket holding the key
+        * @param slot slot of the key
+        * @param to bucket the key may move to
+        * @return false if the move is no longer valid
+    */
+    bool moveKey(size_t from, size_t slot, size_t to) {
+        lockPair(from, to);
+        K moved = buckets[from].keys[slot].load(std::memory_order_relaxed);
+        int free = slotOf(to, EMPTY_KEY);
+        bool valid = moved != EMPTY_KEY && free >= 0
+         && alternateBucket(moved, from) == to;
+        if (valid) {
+            Bucket& target = buckets[to];
+            target.values[free].store(buckets[from].values[slot]
+             .load(std::memory_order_relaxed), std::memory_order_relaxed);
+            target.keys[free].store(moved, std::memory_order_relaxed);
+            buckets[from].keys[slot].store(EMPTY_KEY,
+             std::memory_order_relaxed);
+            buckets[from].values[slot].store(nullptr,
+             std::memory_order_relaxed);
+        }
+        unlockPair(from, to);
+        return valid;
+    }
+
+ public:
+    /*
+        * Constructor
+        * @param slotCount number of slots, rounded up so that the
+        * number of buckets is a power of two
+    */
+    explicit ConcurrentCuckooHashing(size_t slotCount = 101)
+        : size_(0) {
+        bucketCount = roundUpToPowerOfTwo((slotCount + SLOTS - 1) / SLOTS);
+        lockCount = bucketCount < MAX_LOCKS ? bucketCount : MAX_LOCKS;
+        buckets = new Bucket[bucketCount];
+        locks = new std::atomic<uint64_t>[lockCount];
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                buckets[i].keys[j].store(EMPTY_KEY, std::memory_order_relaxed);
+                buckets[i].values[j].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < lockCount; ++i) {
+            locks[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentCuckooHashing(const ConcurrentCuckooHashing&) = delete;
+    ConcurrentCuckooHashing& operator=(
+     const ConcurrentCuckooHashing&) = delete;
+
+    /*
+        * Get load factor of hash table
+        * @return load factor
+    */
+    float getLoadFactor() override {
+        return static_cast<float>(size()) / (bucketCount * SLOTS);
+    }
+
+    /*
+        * Gather bucket occupancy, read without stopping writers.
+        * Displacements are not tracked: counting them would make every
+        * insert write to shared counters.
+        * @return statistics
+    */
+    TableStats stats() override {
+        TableStats stats;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            size_t used = 0;
+            for (size_t j = 0; j < SLOTS; ++j) {
+                used += buckets[i].keys[j].load(std::memory_order_relaxed)
+                 != EMPTY_KEY;
+            }
+            countInHistogram(stats.bucketOccupancy, used);
+            stats.elements += used;
+        }
+        stats.capacity = bucketCount * SLOTS;
+        stats.loadFactor = static_cast<float>(stats.elements)
+         / static_cast<float>(stats.capacity);
+        stats.bytesUsed = bucketCount * sizeof(Bucket)
+         + lockCount * sizeof(std::atomic<uint64_t>)
+         + stats.elements * sizeof(V);
+        return stats;
+    }
+
+    /*
+        * Insert key-value pair, replacing the value of an existing key
+        * @param key key to insert
+        * @param value value to insert
+        * @throws std::invalid_argument if key is EMPTY_KEY
+        * @throws std::overflow_error if no eviction path frees a slot
+    */
+    void insert(const K& key, const V& value) override {
+        if (key == EMPTY_KEY)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        EpochGuard guard;
+        V* fresh = new V(value);
+        size_t first = bucket1(key);
+        size_t second = bucket2(key);
+        std::vector<PathNode> nodes;
+        for (;;) {
+            lockPair(first, second);
+            size_t bucket = first;
+            int slot = slotOf(first, key);
+            if (slot < 0) {
+                bucket = second;
+                slot = slotOf(second, key);
+            }
+            if (slot >= 0) {
+                V* old = buckets[bucket].values[slot]
+                 .exchange(fresh, std::memory_order_relaxed);
+                unlockPair(first, second);
+                guard.retire(old);
+                return;
+            }
+            bucket = first;
+            slot = slotOf(first, EMPTY_KEY);
+            if (slot < 0) {
+                bucket = second;
+                slot = slotOf(second, EMPTY_KEY);
+            }
+            if (slot >= 0) {
+                buckets[bucket].values[slot].store(fresh,
+                 std::memory_order_relaxed);
+                buckets[bucket].keys[slot].store(key,
+                 std::memory_order_relaxed);
+                unlockPair(first, second);
+                size_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            unlockPair(first, second);
+
+            int node = findPath(key, nodes);
+            if (node < 0) {
+                delete fresh;
+                throw std::overflow_error("HashTable is full");
+            }
+            // Shift keys along the path from its free end; a failed check
+            // means another writer got there first, so search again
+            while (nodes[node].parent >= 0
+             && moveKey(nodes[nodes[node].parent].bucket, nodes[node].slot,
+              nodes[node].bucket)) {
+                node = nodes[node].parent;
+            }
+        }
+    }
+
+    /*
+        * Insert many key-value pairs at once, split into equal chunks that
+        * threads insert concurrently
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+        * @throws std::invalid_argument if a key is EMPTY_KEY, before any
+        * pair is inserted
+        * @throws std::overflow_error if no slot is left for a new key
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        if (std::find(keys, keys + count, EMPTY_KEY) != keys + count)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        unsigned threads = buildThreadCount(count);
+        size_t chunkSize = (count + threads - 1) / threads;
+        parallelFor(threads, threads, [&](size_t chunk) {
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (size_t i = chunk * chunkSize; i < end; ++i) {
+                insert(keys[i], values[i]);
+            }
+        });
+    }
+
+    /*
+        * Search for key in hash table
+        * @param key key to search for
+        * @return value associated with key
+        * @throws std::out_of_range if key not found
+    */
+    V search(const K& key) override {
+        EpochGuard guard;
+        V* value = read(key);
+        if (!value) {
+            throw std::out_of_range("Key not found");
+        }
+        return *value;
+    }
+
+    /*
+        * Remove key from hash table
+        * @param key key to remove
+        * @throws std::out_of_range if key not found
+    */
+    void remove(const K& key) override {
+        if (key == EMPTY_KEY)
+            throw std::out_of_range("Key not found");
+        EpochGuard guard;
+        size_t first = bucket1(key);
+        size_t second = bucket2(key);
+        lockPair(first, second);
+        size_t bucket = first;
+        int slot = slotOf(first, key);
+        if (slot < 0) {
+            bucket = second;
+            slot = slotOf(second, key);
+        }
+        if (slot < 0) {
+            unlockPair(first, second);
+            throw std::out_of_range("Key not found");
+        }
+        V* old = buckets[bucket].values[slot]
+         .exchange(nullptr, std::memory_order_relaxed);
+        buckets[bucket].keys[slot].store(EMPTY_KEY, std::memory_order_relaxed);
+        unlockPair(first, second);
+        guard.retire(old);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /*
+        * Check if key exists in hash table
+        * @param key key to check
+        * @return true if key exists, false otherwise
+    */
+    bool exists(const K& key) override {
+        EpochGuard guard;
+        return read(key) != nullptr;
+    }
+
+    /*
+        * Get number of elements in hash table
+        * @return number of elements
+    */
+    size_t size() override {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    /*
+        * Check if hash table is empty
+        * @return true if hash table is empty, false otherwise
+    */
+    bool empty() override {
+        return size() == 0;
+    }
+
+    /*
+        * Print all keys in hash table
+    */
+    void keys() override {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                K key = buckets[i].keys[j].load();
+                if (key != EMPTY_KEY) {
+                    std::cout << key << " ";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    /*
+        * Print all values in hash table
+    */
+    void values() override {
+        EpochGuard guard;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                V* value = buckets[i].values[j].load();
+                if (value) {
+                    std::cout << *value << " ";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    /*
+        * Print hash table
+    */
+    void print() override {
+        EpochGuard guard;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            std::cout << "Bucket " << i << ":";
+            for (size_t j = 0; j < SLOTS; ++j) {
+                V* value = buckets[i].values[j].load();
+                std::cout << " (" << buckets[i].keys[j].load() << ", "
+                 << (value ? *value : V()) << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    /*
+        * Destructor
+    */
+    ~ConcurrentCuckooHashing() override {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            for (size_t j = 0; j < SLOTS; ++j) {
+                delete buckets[i].values[j].load(std::memory_order_relaxed);
+            }
+        }
+        delete[] buckets;
+        delete[] locks;
+    }
+};
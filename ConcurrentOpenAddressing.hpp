@@ -0,0 +1,552 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+#include "./ParallelBuild.hpp"
+#include "./EpochReclamation.hpp"
+
+/*
+    * Lock-free open addressing with linear probing for keys that fit a
+    * lock-free std::atomic, such as int. A thread claims a slot by a CAS
+    * from EMPTY_KEY to its key; a claimed slot keeps its key for as long
+    * as its slot array lives, so probe sequences never change under a
+    * reader. The value is published through an atomic pointer, and a
+    * removed key leaves a tombstone value that a later insert of the same
+    * key revives. EMPTY_KEY itself, -1, cannot be stored: inserting it
+    * throws and lookups never find it.
+    *
+    * Once claimed slots, tombstones included, pass MAX_LOAD_FACTOR of an
+    * array, writers migrate the live keys into a new array, twice as
+    * large if at least half of them are live and as large otherwise, so
+    * churn drops its tombstones instead of filling the table. Migration
+    * seals every slot, copies its value over and marks it moved; a writer
+    * that meets a migration helps finish it before going on, and a reader
+    * follows moved slots into the new array, so no thread ever waits for
+    * another. Writers hold no lock at all, which leaves no point at which
+    * a replaced value, a removed one or an outgrown array is unreachable
+    * for certain: each operation pins an epoch, and that memory is freed
+    * through EpochReclamation.hpp once every thread pinned later.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class ConcurrentOpenAddressing : public HashTable<K, V> {
+ private:
+    static_assert(std::atomic<K>::is_always_lock_free,
+     "ConcurrentOpenAddressing needs lock-free atomic keys");
+
+    // One generation of slots, linked to the one it is migrating into
+    struct Slots {
+        size_t capacity;  // power of two
+        std::atomic<K>* keys;
+        std::atomic<V*>* values;
+        std::atomic<size_t> claimed;  // keys claimed, tombstones included
+        std::atomic<size_t> copyNext;  // first slot no thread copies yet
+        std::atomic<size_t> copied;  // slots marked moved
+        std::atomic<Slots*> next;
+
+        explicit Slots(size_t count)
+            : capacity(count), keys(new std::atomic<K>[count]),
+              values(new std::atomic<V*>[count]), claimed(0), copyNext(0),
+              copied(0), next(nullptr) {
+            for (size_t i = 0; i < count; ++i) {
+                keys[i].store(EMPTY_KEY, std::memory_order_relaxed);
+                values[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ~Slots() {
+            delete[] keys;
+            delete[] values;
+        }
+    };
+
+    std::atomic<Slots*> active;
+    std::atomic<size_t> numElements;
+    std::atomic<size_t> migrations;
+    Hash hasher;
+
+    static constexpr K EMPTY_KEY = -1;
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr size_t COPY_CHUNK = 256;  // slots a helper copies at once
+    static constexpr float MAX_LOAD_FACTOR = 0.75f;
+
+    // A value pointer carries the state of its slot. Heap values are at
+    // least 8-byte aligned, which leaves the low bits for a seal mark and
+    // two small constants.
+    static V* tombstone() { return reinterpret_cast<V*>(uintptr_t(2)); }
+    static V* moved() { return reinterpret_cast<V*>(uintptr_t(4)); }
+    static bool isSealed(V* value) {
+        return reinterpret_cast<uintptr_t>(value) & 1;
+    }
+    static V* seal(V* value) {
+        return reinterpret_cast<V*>(reinterpret_cast<uintptr_t>(value) | 1);
+    }
+    static V* unseal(V* value) {
+        return reinterpret_cast<V*>(reinterpret_cast<uintptr_t>(value) & ~1);
+    }
+    static bool isLive(V* value) {
+        return value && value != tombstone() && value != moved();
+    }
+
+    /*
+        * Find the value of key, following moved slots into newer arrays
+        * @param key key to search for
+        * @return value or nullptr if key not found
+    */
+    V* read(const K& key) const {
+        if (key == EMPTY_KEY)
+            return nullptr;
+        Slots* slots = active.load(std::memory_order_acquire);
+        for (;;) {
+            size_t mask = slots->capacity - 1;
+            size_t index = hasher(key) & mask;
+            V* value = nullptr;
+            bool follow = true;  // key may live in a newer array
+            for (size_t i = 0; i < slots->capacity; ++i) {
+                K current = slots->keys[index].load(std::memory_order_acquire);
+                if (current == key || current == EMPTY_KEY) {
+                    value = slots->values[index]
+                     .load(std::memory_order_acquire);
+                    follow = value == moved();
+                    break;
+                }
+                index = (index + 1) & mask;
+            }
+            Slots* next = slots->next.load(std::memory_order_acquire);
+            if (!follow || !next) {
+                value = unseal(value);
+                return isLive(value) ? value : nullptr;
+            }
+            slots = next;
+        }
+    }
+
+    /*
+        * Put a value into the array a migration fills, unless the key
+        * already got one there
+        * @param slots array being filled
+        * @param key key to copy
+        * @param value value of key
+    */
+    void copyInto(Slots* slots, const K& key, V* value) {
+        size_t mask = slots->capacity - 1;
+        size_t index = hasher(key) & mask;
+        for (;;) {
+            K current = slots->keys[index].load(std::memory_order_acquire);
+            if (current == EMPTY_KEY) {
+                if (slots->keys[index].compare_exchange_strong(current, key,
+                 std::memory_order_acq_rel)) {
+                    slots->claimed.fetch_add(1, std::memory_order_relaxed);
+                    current = key;
+                }
+            }
+            if (current == key) {
+                // Fails if the value was copied already, or replaced or
+                // removed once the migration was over
+                V* expected = nullptr;
+                slots->values[index].compare_exchange_strong(expected, value,
+                 std::memory_order_acq_rel);
+                return;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    /*
+        * Move one slot into the next array: seal its value so writers
+        * leave it alone, copy it, then mark the slot moved. Removed keys
+        * and empty slots are marked moved straight away.
+        * @param slots array being migrated
+        * @param index slot to move
+        * @return true if this call marked the slot moved
+    */
+    bool copySlot(Slots* slots, size_t index) {
+        std::atomic<V*>& slot = slots->values[index];
+        V* value = slot.load(std::memory_order_acquire);
+        for (;;) {
+            if (value == moved())
+                return false;
+            if (isSealed(value))
+                break;
+            V* target = isLive(value) ? seal(value) : moved();
+            if (slot.compare_exchange_weak(value, target,
+             std::memory_order_acq_rel)) {
+                if (target == moved())
+                    return true;
+                value = target;
+                break;
+            }
+        }
+        copyInto(slots->next.load(std::memory_order_acquire),
+         slots->keys[index].load(std::memory_order_acquire), unseal(value));
+        return slot.compare_exchange_strong(value, moved(),
+         std::memory_order_acq_rel);
+    }
+
+    /*
+        * Start migrating an array unless a migration already started
+        * @param slots array to migrate
+    */
+    void startMigration(Slots* slots) {
+        if (slots->next.load(std::memory_order_acquire))
+            return;
+        size_t live = numElements.load(std::memory_order_relaxed);
+        size_t capacity = slots->capacity;
+        if (live * 2 >= slots->claimed.load(std::memory_order_relaxed))
+            capacity *= 2;
+        Slots* next = new Slots(capacity);
+        Slots* expected = nullptr;
+        if (!slots->next.compare_exchange_strong(expected, next,
+         std::memory_order_acq_rel))
+            delete next;
+    }
+
+    /*
+        * Help finish the migration of an array and make its successor
+        * current. Copies chunks no thread took yet, then, if another thread
+        * still copies one, every slot left, so it never waits for that
+        * thread.
+        * @param slots array being migrated
+        * @param guard epoch guard of the calling operation
+    */
+    void migrate(Slots* slots, EpochGuard& guard) {
+        Slots* next = slots->next.load(std::memory_order_acquire);
+        for (;;) {
+            size_t first = slots->copyNext.fetch_add(COPY_CHUNK,
+             std::memory_order_relaxed);
+            if (first >= slots->capacity)
+                break;
+            size_t last = std::min(slots->capacity, first + COPY_CHUNK);
+            size_t done = 0;
+            for (size_t i = first; i < last; ++i) {
+                done += copySlot(slots, i);
+            }
+            slots->copied.fetch_add(done, std::memory_order_acq_rel);
+        }
+        if (slots->copied.load(std::memory_order_acquire) < slots->capacity) {
+            size_t done = 0;
+            for (size_t i = 0; i < slots->capacity; ++i) {
+                done += copySlot(slots, i);
+            }
+            slots->copied.fetch_add(done, std::memory_order_acq_rel);
+        }
+        Slots* expected = slots;
+        if (active.compare_exchange_strong(expected, next,
+         std::memory_order_acq_rel)) {
+            migrations.fetch_add(1, std::memory_order_relaxed);
+            guard.retire(slots);
+        }
+    }
+
+    /*
+        * Current array with no migration under way, helping any first
+        * @param guard epoch guard of the calling operation
+        * @return array writers may change
+    */
+    Slots* writable(EpochGuard& guard) {
+        for (;;) {
+            Slots* slots = active.load(std::memory_order_acquire);
+            if (!slots->next.load(std::memory_order_acquire))
+                return slots;
+            migrate(slots, guard);
+        }
+    }
+
+    /*
+        * Find slot claimed by key in an array
+        * @param slots array to search
+        * @param key key to search for
+        * @return slot index or capacity if key is not in the array
+    */
+    size_t find(Slots* slots, const K& key) const {
+        size_t mask = slots->capacity - 1;
+        size_t index = hasher(key) & mask;
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            K current = slots->keys[index].load(std::memory_order_acquire);
+            if (current == key)
+                return index;
+            if (current == EMPTY_KEY)
+                break;
+            index = (index + 1) & mask;
+        }
+        return slots->capacity;
+    }
+
+ public:
+    /*
+        * Constructor
+        * @param size initial number of slots, rounded up to a power of two
+    */
+    explicit ConcurrentOpenAddressing(size_t size = 101)
+        : active(new Slots(roundUpToPowerOfTwo(
+           std::max(size, MIN_CAPACITY)))),
+          numElements(0), migrations(0) {}
+
+    ConcurrentOpenAddressing(const ConcurrentOpenAddressing&) = delete;
+    ConcurrentOpenAddressing& operator=(
+     const ConcurrentOpenAddressing&) = delete;
+
+    /*
+        * Insert key-value pair, replacing the value of an existing key
+        * @param key key to insert
+        * @param value value to insert
+        * @throws std::invalid_argument if key is EMPTY_KEY
+    */
+    void insert(const K& key, const V& value) override {
+        if (key == EMPTY_KEY)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        EpochGuard guard;
+        V* fresh = new V(value);
+        for (;;) {
+            Slots* slots = writable(guard);
+            size_t mask = slots->capacity - 1;
+            size_t index = hasher(key) & mask;
+            bool claimedHere = false;
+            size_t i = 0;
+            for (; i < slots->capacity; ++i) {
+                K current = slots->keys[index].load(std::memory_order_acquire);
+                if (current == EMPTY_KEY) {
+                    // On failure `current` becomes the key that won the slot
+                    if (slots->keys[index].compare_exchange_strong(current,
+                     key, std::memory_order_acq_rel)) {
+                        claimedHere = true;
+                        current = key;
+                    }
+                }
+                if (current == key)
+                    break;
+                index = (index + 1) & mask;
+            }
+            if (i == slots->capacity) {
+                startMigration(slots);
+                continue;
+            }
+            bool grow = claimedHere && slots->claimed.fetch_add(1,
+             std::memory_order_relaxed) + 1
+             > slots->capacity * MAX_LOAD_FACTOR;
+            std::atomic<V*>& slot = slots->values[index];
+            V* old = slot.load(std::memory_order_acquire);
+            // A sealed or moved value belongs to a migration, after which
+            // the key is written in the new array
+            while (!isSealed(old) && old != moved()
+             && !slot.compare_exchange_weak(old, fresh,
+              std::memory_order_acq_rel)) {}
+            if (isSealed(old) || old == moved())
+                continue;
+            if (isLive(old))
+                guard.retire(old);
+            else
+                numElements.fetch_add(1, std::memory_order_relaxed);
+            if (grow) {
+                startMigration(slots);
+                migrate(slots, guard);
+            }
+            return;
+        }
+    }
+
+    /*
+        * Insert many key-value pairs at once, split into equal chunks that
+        * threads insert concurrently
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+        * @throws std::invalid_argument if a key is EMPTY_KEY, before any
+        * pair is inserted
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        if (std::find(keys, keys + count, EMPTY_KEY) != keys + count)
+            throw std::invalid_argument("Key reserved as empty slot marker");
+        unsigned threads = buildThreadCount(count);
+        size_t chunkSize = (count + threads - 1) / threads;
+        parallelFor(threads, threads, [&](size_t chunk) {
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (size_t i = chunk * chunkSize; i < end; ++i) {
+                insert(keys[i], values[i]);
+            }
+        });
+    }
+
+    /*
+        * Search for key in hash table
+        * @param key key to search for
+        * @return value associated with key
+        * @throws std::range_error if key not found
+    */
+    V search(const K& key) override {
+        EpochGuard guard;
+        V* value = read(key);
+        if (!value)
+            throw std::range_error("Key not found");
+        return *value;
+    }
+
+    /*
+        * Remove key from hash table, leaving a tombstone in its slot until
+        * the next migration
+        * @param key key to remove
+        * @throws std::range_error if key not found
+    */
+    void remove(const K& key) override {
+        if (key == EMPTY_KEY)
+            throw std::range_error("Key not found");
+        EpochGuard guard;
+        for (;;) {
+            Slots* slots = writable(guard);
+            size_t index = find(slots, key);
+            // The probe may have hit a slot a migration that began since
+            // had already moved
+            if (index == slots->capacity
+             && slots->next.load(std::memory_order_acquire))
+                continue;
+            if (index == slots->capacity)
+                throw std::range_error("Key not found");
+            std::atomic<V*>& slot = slots->values[index];
+            V* old = slot.load(std::memory_order_acquire);
+            while (isLive(old) && !isSealed(old)
+             && !slot.compare_exchange_weak(old, tombstone(),
+              std::memory_order_acq_rel)) {}
+            if (isSealed(old) || old == moved())
+                continue;
+            if (!isLive(old))
+                throw std::range_error("Key not found");
+            guard.retire(old);
+            numElements.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    /*
+        * Check if key exists in hash table
+        * @param key key to check
+        * @return true if key exists, false otherwise
+    */
+    bool exists(const K& key) override {
+        EpochGuard guard;
+        return read(key) != nullptr;
+    }
+
+    /*
+        * Get number of elements in hash table
+        * @return number of elements
+    */
+    size_t size() override {
+        return numElements.load(std::memory_order_relaxed);
+    }
+
+    /*
+        * Check if hash table is empty
+        * @return true if hash table is empty, false otherwise
+    */
+    bool empty() override {
+        return size() == 0;
+    }
+
+    /*
+        * Print all keys in hash table
+    */
+    void keys() override {
+        EpochGuard guard;
+        Slots* slots = active.load(std::memory_order_acquire);
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            if (isLive(unseal(slots->values[i].load()))) {
+                std::cout << slots->keys[i].load() << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Print all values in hash table
+    */
+    void values() override {
+        EpochGuard guard;
+        Slots* slots = active.load(std::memory_order_acquire);
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            V* value = unseal(slots->values[i].load());
+            if (isLive(value)) {
+                std::cout << *value << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Get load factor of hash table, counting removed keys' slots
+        * @return load factor
+    */
+    float getLoadFactor() override {
+        EpochGuard guard;
+        Slots* slots = active.load(std::memory_order_acquire);
+        return static_cast<float>(slots->claimed.load())
+         / static_cast<float>(slots->capacity);
+    }
+
+    /*
+        * Gather statistics of the current array, read without stopping
+        * writers. Tombstones are slots still claimed by a removed key;
+        * boxed values count towards bytesUsed, retired ones do not.
+        * Rehashes are completed migrations.
+        * @return statistics
+    */
+    TableStats stats() override {
+        EpochGuard guard;
+        TableStats stats;
+        Slots* slots = active.load(std::memory_order_acquire);
+        size_t mask = slots->capacity - 1;
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            K key = slots->keys[i].load(std::memory_order_acquire);
+            if (key == EMPTY_KEY)
+                continue;
+            if (!isLive(unseal(slots->values[i].load()))) {
+                ++stats.tombstones;
+                continue;
+            }
+            ++stats.elements;
+            countInHistogram(stats.probeLengths,
+             (i - (hasher(key) & mask)) & mask);
+        }
+        stats.capacity = slots->capacity;
+        stats.loadFactor = static_cast<float>(stats.elements)
+         / static_cast<float>(slots->capacity);
+        stats.rehashes = migrations.load(std::memory_order_relaxed);
+        stats.bytesUsed = slots->capacity * (sizeof(std::atomic<K>)
+         + sizeof(std::atomic<V*>)) + stats.elements * sizeof(V);
+        return stats;
+    }
+
+    /*
+        * Print all key-value pairs in hash table
+    */
+    void print() override {
+        EpochGuard guard;
+        Slots* slots = active.load(std::memory_order_acquire);
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            V* value = unseal(slots->values[i].load());
+            if (isLive(value)) {
+                std::cout << "Key: " << slots->keys[i].load() <<
+                 ", Value: " << *value << std::endl;
+            } else {
+                std::cout << "Empty" << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Destructor
+    */
+    ~ConcurrentOpenAddressing() override {
+        Slots* slots;
+        {
+            EpochGuard guard;
+            slots = writable(guard);
+        }
+        for (size_t i = 0; i < slots->capacity; ++i) {
+            V* value = slots->values[i].load(std::memory_order_relaxed);
+            if (isLive(value))
+                delete value;
+        }
+        delete slots;
+    }
+};
@@ -1,103 +1,258 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 #include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+#include "./SlotLayout.hpp"
+#include "./Snapshot.hpp"
 
-template <typename K, typename V>
+template <typename K, typename V, typename Layout = PairLayout<K, V>,
+ typename Hash = WyMixHash<K>>
 class CuckooHashing : public HashTable<K, V> {
  private:
-    std::pair<K, V> *table1, *table2;
-    size_t tableSize;
+    Layout table1, table2;
+    size_t tableSize;  // power of two
     size_t size_;
+    Hash hasher;
+
+    // Seeds of both hash functions, replaced on every rehash. seed1 == 0
+    // keeps the first position the plain hash policy result.
+    uint64_t seed1, seed2;
+    uint64_t seedState;
+    size_t rehashCount;
+    size_t growthCount;
+    // Keys moved by each insert, and by all of them together
+    std::vector<size_t> displacementHistogram;
+    size_t evictionCount;
 
-    static constexpr K EMPTY_KEY = -1;
-    static constexpr int INSERTION_ATTEMPTS = 10000;
+    static constexpr int INSERTION_ATTEMPTS = 500;
+    static constexpr float MAX_LOAD_FACTOR = 0.45f;  // of both tables
+    static constexpr int REHASHES_BEFORE_GROWTH = 4;
+    static constexpr size_t BATCH_SIZE = 16;  // lookups in flight per batch
 
     /*
     * First hash function
-    * @param: K key
+    * @param: Q key, a K or a type Hash is transparent for
     * @return: size_t
     */
-    size_t hash1(const K& key) {
-        return key*3 % tableSize;
+    template <typename Q>
+    size_t hash1(const Q& key) {
+        uint64_t h = hasher(key);
+        return (seed1 ? remixHash(h ^ seed1) : h) & (tableSize - 1);
     }
 
     /*
     * Second hash function
-    * @param: K key
+    * @param: Q key, a K or a type Hash is transparent for
     * @return: size_t
     */
-    size_t hash2(const K& key) {
-        return (key * (key+3)) % tableSize;
+    template <typename Q>
+    size_t hash2(const Q& key) {
+        // Remixed so that the second position stays independent of the
+        // first one even for weak hash policies
+        return remixHash(hasher(key) ^ seed2) & (tableSize - 1);
     }
 
     /*
-    * Helper function to insert key-value pair
-    * @param: K key key to insert
-    * @param: V value value to insert
-    * @param: int iteration count of insertion attempts
-    * @return: bool
-    * @throws: std::overflow_error if cycle detected
+    * Draw fresh seeds for both hash functions (splitmix64 sequence)
     */
-    bool insertHelper(K key, V value, int count) {
-        if (count > INSERTION_ATTEMPTS) {
-            throw std::overflow_error("Cycle detected");
+    void reseed() {
+        for (uint64_t* seed : {&seed1, &seed2}) {
+            uint64_t z = (seedState += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            *seed = (z ^ (z >> 31)) | 1;
         }
+    }
 
-        size_t index1 = hash1(key);
+    /*
+    * Helper function to insert key-value pair known to be absent,
+    * kicking entries between both tables
+    * @param: std::pair<K, V>& entry entry to insert; if no free slot was
+    * found in INSERTION_ATTEMPTS rounds it holds the entry left without
+    * a slot, every other entry is in the tables
+    * @param: size_t& displaced set to the number of stored keys kicked out
+    * @return: bool false if an entry was left without a slot
+    */
+    bool insertHelper(std::pair<K, V>& entry, size_t& displaced) {
+        displaced = 0;
+        for (int count = 0; count <= INSERTION_ATTEMPTS; ++count) {
+            size_t index1 = hash1(entry.first);
+            if (!table1.occupied(index1)) {
+                table1.set(index1, entry.first, entry.second);
+                return true;
+            }
+            std::swap(table1.key(index1), entry.first);
+            table1.swapValue(index1, entry.second);
+            ++displaced;
 
-        if (table1[index1].first == EMPTY_KEY
-         || table1[index1].first == key) {
-            table1[index1] = std::make_pair(key, value);
-            return true;
+            size_t index2 = hash2(entry.first);
+            if (!table2.occupied(index2)) {
+                table2.set(index2, entry.first, entry.second);
+                return true;
+            }
+            std::swap(table2.key(index2), entry.first);
+            table2.swapValue(index2, entry.second);
+            ++displaced;
         }
+        return false;
+    }
 
-        std::pair<K, V> temp = std::make_pair(key, value);
-        std::swap(table1[index1], temp);
+    /*
+    * Rebuild both tables with fresh seeds, doubling them when asked to or
+    * when a few seeds in a row fail. Entries are kept aside until one
+    * rebuild places all of them, so nothing is lost.
+    * @param: size_t newSize size of each new table
+    * @param: std::pair<K, V>* pending entry without a slot or nullptr
+    */
+    void rehash(size_t newSize, std::pair<K, V>* pending) {
+        std::vector<std::pair<K, V>> entries;
+        entries.reserve(size_ + 1);
+        for (Layout* table : {&table1, &table2}) {
+            for (size_t i = 0; i < tableSize; ++i) {
+                if (table->occupied(i)) {
+                    entries.emplace_back(std::move(table->key(i)),
+                     std::move(table->value(i)));
+                }
+            }
+        }
+        if (pending)
+            entries.push_back(std::move(*pending));
+        if (newSize > tableSize)
+            ++growthCount;
+        for (int attempt = 1;; ++attempt) {
+            ++rehashCount;
+            reseed();
+            table1 = Layout(newSize);
+            table2 = Layout(newSize);
+            tableSize = newSize;
+            bool placed = true;
+            size_t displaced;
+            for (size_t i = 0; placed && i < entries.size(); ++i) {
+                std::pair<K, V> entry = entries[i];
+                placed = insertHelper(entry, displaced);
+            }
+            if (placed)
+                return;
+            if (attempt % REHASHES_BEFORE_GROWTH == 0) {
+                newSize *= 2;
+                ++growthCount;
+            }
+        }
+    }
 
-        size_t index2 = hash2(temp.first);
 
-        if (table2[index2].first == EMPTY_KEY
-         || table2[index2].first == temp.first) {
-            table2[index2] = temp;
-            return true;
+    /*
+    * Hash a batch of keys and prefetch both candidate slots of each one
+    * @param: const K* keys keys of the batch
+    * @param: size_t count number of keys, at most BATCH_SIZE
+    * @param: size_t* index1 set to the slot of each key in table1
+    * @param: size_t* index2 set to the slot of each key in table2
+    */
+    void prefetchBatch(const K* keys, size_t count,
+     size_t* index1, size_t* index2) {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
+        for (size_t i = 0; i < count; ++i) {
+            index1[i] = hash1(keys[i]);
+            index2[i] = hash2(keys[i]);
+            slots1.prefetch(index1[i]);
+            slots2.prefetch(index2[i]);
         }
+    }
 
-        std::swap(table2[index2], temp);
+    /*
+    * Check if a slot holds key. Keys are compared first, so the state of
+    * the slot is only read once they match.
+    * @param: const Layout& slots table holding the slot
+    * @param: size_t index slot to check
+    * @param: Q key, a K or a type Hash is transparent for
+    * @return: bool
+    */
+    template <typename Q>
+    static bool holds(const Layout& slots, size_t index, const Q& key) {
+        return slots.key(index) == key && slots.occupied(index);
+    }
 
-        return insertHelper(temp.first, temp.second, count + 1);
+    /*
+    * Find slot holding key in either table
+    * @param: Q key, a K or a type Hash is transparent for
+    * @param: size_t& index set to the slot index if key is found
+    * @return: Layout* table holding key or nullptr if key not found
+    */
+    template <typename Q>
+    Layout* find(const Q& key, size_t& index) {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
+        index = hash1(key);
+        if (holds(slots1, index, key))
+            return &table1;
+        index = hash2(key);
+        if (holds(slots2, index, key))
+            return &table2;
+        return nullptr;
     }
 
+    /*
+    * Search for key
+    * @param: Q key, a K or a type Hash is transparent for
+    * @return: V
+    * @throws: std::out_of_range if key not found
+    */
+    template <typename Q>
+    V searchKey(const Q& key) {
+        size_t index;
+        const Layout* slots = find(key, index);
+        if (slots)
+            return slots->value(index);
+        throw std::out_of_range("Key not found");
+    }
+
+    /*
+    * Remove key
+    * @param: Q key, a K or a type Hash is transparent for
+    * @throws: std::out_of_range if key not found
+    */
+    template <typename Q>
+    void removeKey(const Q& key) {
+        size_t index;
+        Layout* slots = find(key, index);
+        if (!slots)
+            throw std::out_of_range("Key not found");
+        slots->clear(index, SlotState::Empty);
+        --size_;
+    }
 
  public:
     /*
     * Constructor
-    * @param: size_t bucketCount
+    * @param: size_t bucketCount, rounded up to a power of two
     */
     explicit CuckooHashing(size_t bucketCount = 101)
-     : tableSize(bucketCount), size_(0) {
-        table1 = new std::pair<K, V>[tableSize];
-        table2 = new std::pair<K, V>[tableSize];
-        for (size_t i = 0; i < tableSize; ++i) {
-            table1[i].first = EMPTY_KEY;
-            table2[i].first = EMPTY_KEY;
-        }
-    }
+     : table1(roundUpToPowerOfTwo(bucketCount)),
+       table2(roundUpToPowerOfTwo(bucketCount)),
+       tableSize(table1.capacity()), size_(0), seed1(0), seed2(0),
+       seedState(0), rehashCount(0), growthCount(0), evictionCount(0) {}
 
     /*
     * Copy constructor
     * @param: CuckooHashing object to copy
     */
-    CuckooHashing(const CuckooHashing& other) {
+    CuckooHashing(const CuckooHashing& other)
+     : table1(other.table1), table2(other.table2) {
         tableSize = other.tableSize;
         size_ = other.size_;
-        table1 = new std::pair<K, V>[tableSize];
-        table2 = new std::pair<K, V>[tableSize];
-        for (size_t i = 0; i < tableSize; ++i) {
-            table1[i] = other.table1[i];
-            table2[i] = other.table2[i];
-        }
+        seed1 = other.seed1;
+        seed2 = other.seed2;
+        seedState = other.seedState;
+        rehashCount = other.rehashCount;
+        growthCount = other.growthCount;
+        displacementHistogram = other.displacementHistogram;
+        evictionCount = other.evictionCount;
     }
 
     /*
@@ -109,17 +264,87 @@ class CuckooHashing : public HashTable<K, V> {
     }
 
     /*
-    * Insert key-value pair
+    * Return number of rebuilds with fresh hash seeds, growth included
+    * @return: size_t
+    */
+    size_t getRehashCount() const {
+        return rehashCount;
+    }
+
+    /*
+    * Return number of times the tables doubled
+    * @return: size_t
+    */
+    size_t getGrowthCount() const {
+        return growthCount;
+    }
+
+    /*
+    * Gather statistics of both tables. Displacement chains count the
+    * inserts since construction; rehashes re-placing every key are left
+    * out of them.
+    * @return: TableStats
+    */
+    TableStats stats() override {
+        TableStats stats;
+        stats.elements = size_;
+        stats.capacity = 2 * tableSize;
+        stats.loadFactor = getLoadFactor();
+        stats.bytesUsed = table1.bytes() + table2.bytes();
+        stats.displacementChains = displacementHistogram;
+        stats.evictions = evictionCount;
+        stats.rehashes = rehashCount;
+        return stats;
+    }
+
+    /*
+    * Insert key-value pair, replacing the value of an existing key.
+    * A displacement cycle triggers a rehash with fresh seeds and the
+    * tables double once they are too full, so an insert never fails.
     * @param: K key
     * @param: V value
     */
     void insert(const K& key, const V& value) override {
-        if (!insertHelper(key, value, 0)) {
-            throw std::overflow_error("HashTable is full");
+        size_t index;
+        Layout* slots = find(key, index);
+        if (slots) {
+            slots->value(index) = value;
+            return;
+        }
+        if (size_ + 1 > MAX_LOAD_FACTOR * 2 * tableSize) {
+            rehash(tableSize * 2, nullptr);
+        }
+        std::pair<K, V> entry = std::make_pair(key, value);
+        size_t displaced;
+        bool placed = insertHelper(entry, displaced);
+        countInHistogram(displacementHistogram, displaced);
+        evictionCount += displaced;
+        if (!placed) {
+            rehash(tableSize, &entry);
         }
         ++size_;
     }
 
+    /*
+    * Insert many key-value pairs at once. The tables grow once to fit all
+    * of them, then the pairs are inserted one by one: kicking entries
+    * between both tables cannot be split into independent parts.
+    * @param: const K* keys keys to insert
+    * @param: const V* values values to insert, values[i] belongs to keys[i]
+    * @param: size_t count number of pairs
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        size_t newSize = tableSize;
+        while (size_ + count > MAX_LOAD_FACTOR * 2 * newSize) {
+            newSize *= 2;
+        }
+        if (newSize != tableSize)
+            rehash(newSize, nullptr);
+        for (size_t i = 0; i < count; ++i) {
+            insert(keys[i], values[i]);
+        }
+    }
+
     /*
     * Search for key
     * @param: K key
@@ -127,15 +352,21 @@ class CuckooHashing : public HashTable<K, V> {
     * @throws: std::out_of_range if key not found
     */
     V search(const K& key) override {
-        size_t index1 = hash1(key);
-        if (table1[index1].first == key) {
-            return table1[index1].second;
-        }
-        size_t index2 = hash2(key);
-        if (table2[index2].first == key) {
-            return table2[index2].second;
-        }
-        throw std::out_of_range("Key not found");
+        return searchKey(key);
+    }
+
+    /*
+    * Search for a key by another type, such as std::string_view for
+    * std::string keys, without building a K. Only available with a
+    * transparent Hash.
+    * @param: Q key
+    * @return: V
+    * @throws: std::out_of_range if key not found
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    V search(const Q& key) {
+        return searchKey(key);
     }
 
     /*
@@ -144,21 +375,18 @@ class CuckooHashing : public HashTable<K, V> {
     * @throws: std::out_of_range if key not found
     */
     void remove(const K& key) override {
-        size_t index1 = hash1(key);
-        if (table1[index1].first == key) {
-            table1[index1].first = EMPTY_KEY;
-            --size_;
-            table1[index1].second = V();
-            return;
-        }
-        size_t index2 = hash2(key);
-        if (table2[index2].first == key) {
-            table2[index2].first = EMPTY_KEY;
-            --size_;
-            table2[index2].second = V();
-            return;
-        }
-        throw std::out_of_range("Key not found");
+        removeKey(key);
+    }
+
+    /*
+    * Remove a key given by another type, see search()
+    * @param: Q key
+    * @throws: std::out_of_range if key not found
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    void remove(const Q& key) {
+        removeKey(key);
     }
 
     /*
@@ -167,15 +395,145 @@ class CuckooHashing : public HashTable<K, V> {
     * @return: bool
     */
     bool exists(const K& key) override {
-        size_t index1 = hash1(key);
-        if (table1[index1].first == key) {
-            return true;
+        size_t index;
+        return find(key, index) != nullptr;
+    }
+
+    /*
+    * Check if a key given by another type exists, see search()
+    * @param: Q key
+    * @return: bool
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    bool exists(const Q& key) {
+        size_t index;
+        return find(key, index) != nullptr;
+    }
+
+    /*
+    * Check many keys at once, prefetching both candidate slots of every
+    * key of a batch before comparing any of them
+    * @param: const K* keys keys to check
+    * @param: size_t count number of keys
+    * @param: bool* results set to whether each key exists
+    */
+    void existsBatch(const K* keys, size_t count, bool* results) override {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
+        size_t index1[BATCH_SIZE];
+        size_t index2[BATCH_SIZE];
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            prefetchBatch(keys + base, n, index1, index2);
+            for (size_t i = 0; i < n; ++i) {
+                const K& key = keys[base + i];
+                results[base + i] = holds(slots1, index1[i], key)
+                 || holds(slots2, index2[i], key);
+            }
         }
-        size_t index2 = hash2(key);
-        if (table2[index2].first == key) {
-            return true;
+    }
+
+    /*
+    * Search for many keys at once, prefetching both candidate slots of
+    * every key of a batch before comparing any of them
+    * @param: const K* keys keys to search for
+    * @param: size_t count number of keys
+    * @param: V* values set to the value of each key that was found
+    * @param: bool* found set to whether each key was found
+    * @return: size_t number of keys found
+    */
+    size_t searchBatch(const K* keys, size_t count,
+     V* values, bool* found) override {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
+        size_t index1[BATCH_SIZE];
+        size_t index2[BATCH_SIZE];
+        size_t hits = 0;
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            prefetchBatch(keys + base, n, index1, index2);
+            for (size_t i = 0; i < n; ++i) {
+                const K& key = keys[base + i];
+                found[base + i] = true;
+                if (holds(slots1, index1[i], key)) {
+                    values[base + i] = slots1.value(index1[i]);
+                } else if (holds(slots2, index2[i], key)) {
+                    values[base + i] = slots2.value(index2[i]);
+                } else {
+                    found[base + i] = false;
+                    continue;
+                }
+                ++hits;
+            }
         }
-        return false;
+        return hits;
+    }
+
+    /*
+    * Write both tables and their seeds to a snapshot image that
+    * CuckooSnapshot can search in place
+    * @param: std::string path file to write
+    * @throws: std::runtime_error if the file cannot be written
+    */
+    void save(const std::string& path) {
+        SnapshotHeader header = {};
+        header.kind = SnapshotKind::Cuckoo;
+        header.hashCheck = hasher(snapshotHashCheckKey<K>());
+        header.arrayCount = 2;
+        header.slotCount = tableSize;
+        header.elementCount = size_;
+        header.params[0] = seed1;
+        header.params[1] = seed2;
+        header.params[2] = seedState;
+        header.params[3] = rehashCount;
+        header.params[4] = growthCount;
+        auto slot = [&](size_t i) -> std::pair<const Layout*, size_t> {
+            return i < tableSize ? std::make_pair(&table1, i)
+             : std::make_pair(&table2, i - tableSize);
+        };
+        writeSnapshot<K, V>(path, header,
+         [&](size_t i) { auto s = slot(i); return s.first->key(s.second); },
+         [&](size_t i) -> decltype(auto) {
+             auto s = slot(i);
+             return s.first->value(s.second);
+         },
+         [&](size_t i) {
+             auto s = slot(i);
+             return s.first->state(s.second);
+         });
+    }
+
+    /*
+    * Replace the contents of the tables with a snapshot image
+    * @param: std::string path image written by save()
+    * @throws: std::runtime_error if the file is not an image of this
+    * table type
+    */
+    void load(const std::string& path) {
+        SnapshotImage<K, V> image(path, SnapshotKind::Cuckoo,
+         hasher(snapshotHashCheckKey<K>()), MappedAccess::Sequential);
+        const SnapshotHeader& header = image.header();
+        size_t newSize = header.slotCount;
+        Layout slots1(newSize);
+        Layout slots2(newSize);
+        const SlotState* states = image.states();
+        for (size_t i = 0; i < newSize; ++i) {
+            if (states[i] == SlotState::Full)
+                slots1.set(i, image.keys()[i], image.value(i));
+            if (states[newSize + i] == SlotState::Full)
+                slots2.set(i, image.keys()[newSize + i],
+                 image.value(newSize + i));
+        }
+        table1.swap(slots1);
+        table2.swap(slots2);
+        tableSize = newSize;
+        size_ = header.elementCount;
+        seed1 = header.params[0];
+        seed2 = header.params[1];
+        seedState = header.params[2];
+        rehashCount = header.params[3];
+        growthCount = header.params[4];
     }
 
     /*
@@ -198,14 +556,18 @@ class CuckooHashing : public HashTable<K, V> {
     * Print all keys in hash table
     */
     void keys() override {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table1[i].first != EMPTY_KEY) {
-                std::cout << table1[i].first << " ";
+            if (slots1.occupied(i)) {
+                printKey(std::cout, slots1.key(i));
+                std::cout << " ";
             }
         }
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table2[i].first != EMPTY_KEY) {
-                std::cout << table2[i].first << " ";
+            if (slots2.occupied(i)) {
+                printKey(std::cout, slots2.key(i));
+                std::cout << " ";
             }
         }
         std::cout << std::endl;
@@ -215,14 +577,16 @@ class CuckooHashing : public HashTable<K, V> {
     * Print all values in hash table
     */
     void values() override {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table1[i].first != EMPTY_KEY) {
-                std::cout << table1[i].second << " ";
+            if (slots1.occupied(i)) {
+                std::cout << slots1.value(i) << " ";
             }
         }
         for (size_t i = 0; i < tableSize; ++i) {
-            if (table2[i].first != EMPTY_KEY) {
-                std::cout << table2[i].second << " ";
+            if (slots2.occupied(i)) {
+                std::cout << slots2.value(i) << " ";
             }
         }
         std::cout << std::endl;
@@ -232,23 +596,109 @@ class CuckooHashing : public HashTable<K, V> {
     * Print hash table
     */
     void print() override {
+        const Layout& slots1 = table1;
+        const Layout& slots2 = table2;
         std::cout << "Table 1:" << std::endl;
         for (size_t i = 0; i < tableSize; ++i) {
-            std::cout << "  Key: " << table1[i].first <<
-                ", Value: " << table1[i].second << std::endl;
+            if (slots1.occupied(i)) {
+                std::cout << "  Key: ";
+                printKey(std::cout, slots1.key(i));
+                std::cout << ", Value: " << slots1.value(i) << std::endl;
+            } else {
+                std::cout << "  Empty" << std::endl;
+            }
         }
         std::cout << "Table 2:" << std::endl;
         for (size_t i = 0; i < tableSize; ++i) {
-            std::cout << "  Key: " << table2[i].first <<
-                ", Value: " << table2[i].second << std::endl;
+            if (slots2.occupied(i)) {
+                std::cout << "  Key: ";
+                printKey(std::cout, slots2.key(i));
+                std::cout << ", Value: " << slots2.value(i) << std::endl;
+            } else {
+                std::cout << "  Empty" << std::endl;
+            }
         }
     }
 
     /*
     * Destructor
     */
-    ~CuckooHashing() override {
-        delete[] table1;
-        delete[] table2;
+    ~CuckooHashing() override {}
+};
+
+/*
+* Read-only cuckoo table searched directly in a mapped snapshot image,
+* without building the tables. Values are returned as
+* SnapshotValue<V>::View, a string_view for std::string values.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class CuckooSnapshot {
+ private:
+    using Codec = SnapshotValue<V>;
+
+    Hash hasher;
+    SnapshotImage<K, V> image;
+    size_t tableSize;
+    uint64_t seed1, seed2;
+
+    /*
+    * Find slot holding key in either table, hashing as the saved table did
+    * @param: K key
+    * @return: size_t slot index, slots of table2 following those of
+    * table1, or 2 * tableSize if key not found
+    */
+    size_t find(const K& key) const {
+        uint64_t h = hasher(key);
+        const SlotState* states = image.states();
+        size_t index1 = (seed1 ? remixHash(h ^ seed1) : h) & (tableSize - 1);
+        if (image.keys()[index1] == key && states[index1] == SlotState::Full)
+            return index1;
+        size_t index2 = tableSize
+         + (remixHash(h ^ seed2) & (tableSize - 1));
+        if (image.keys()[index2] == key && states[index2] == SlotState::Full)
+            return index2;
+        return 2 * tableSize;
+    }
+
+ public:
+    /*
+    * Constructor, maps an image
+    * @param: std::string path image written by CuckooHashing::save()
+    * @throws: std::runtime_error if the file is not such an image
+    */
+    explicit CuckooSnapshot(const std::string& path)
+     : image(path, SnapshotKind::Cuckoo, Hash()(snapshotHashCheckKey<K>()),
+        MappedAccess::Random),
+       tableSize(image.header().slotCount),
+       seed1(image.header().params[0]), seed2(image.header().params[1]) {}
+
+    /*
+    * Search for key
+    * @param: K key
+    * @return: view of the value associated with key
+    * @throws: std::out_of_range if key not found
+    */
+    typename Codec::View search(const K& key) const {
+        size_t index = find(key);
+        if (index == 2 * tableSize)
+            throw std::out_of_range("Key not found");
+        return Codec::view(image.values()[index], image.heap());
+    }
+
+    /*
+    * Check if key exists
+    * @param: K key
+    * @return: bool
+    */
+    bool exists(const K& key) const {
+        return find(key) != 2 * tableSize;
+    }
+
+    /*
+    * Return number of elements
+    * @return: size_t
+    */
+    size_t size() const {
+        return image.header().elementCount;
     }
 };
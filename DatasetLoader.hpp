@@ -0,0 +1,113 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "./MappedFile.hpp"
+
+/*
+    * Loader for the "key value" dataset files, one pair per line. A file
+    * is mapped into memory and scanned in place: keys are parsed with
+    * std::from_chars and values are views into the mapping, so nothing
+    * is copied until a table stores the value.
+*/
+
+/*
+    * Parsed dataset file. The values view into `file`, so they stay
+    * valid as long as the dataset lives.
+*/
+struct Dataset {
+    MappedFile file;
+    std::vector<int> keys;
+    std::vector<std::string_view> values;
+
+    explicit Dataset(const std::string& path)
+        : file(path, MappedAccess::Sequential) {}
+};
+
+/*
+    * Parse "key value" lines. A line ends at '\n', a trailing '\r' is not
+    * part of the value and lines without a key are skipped.
+    * @param begin first character of the text
+    * @param end one past the last character
+    * @param keys parsed keys are appended here
+    * @param values value views are appended here, values[i] for keys[i]
+*/
+inline void parseDataset(const char* begin, const char* end,
+ std::vector<int>& keys, std::vector<std::string_view>& values) {
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(
+         std::memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+        int key;
+        std::from_chars_result parsed = std::from_chars(line, lineEnd, key);
+        if (parsed.ec == std::errc()) {
+            const char* value = parsed.ptr < lineEnd ? parsed.ptr + 1 : lineEnd;
+            const char* valueEnd = lineEnd;
+            if (valueEnd > value && valueEnd[-1] == '\r')
+                --valueEnd;
+            keys.push_back(key);
+            values.emplace_back(value, valueEnd - value);
+        }
+        line = lineEnd + 1;
+    }
+}
+
+/*
+    * Map and parse one dataset file
+    * @param path file to load
+    * @return parsed dataset
+    * @throws std::runtime_error if the file cannot be opened or mapped
+*/
+inline Dataset loadDataset(const std::string& path) {
+    Dataset dataset(path);
+    // Dataset lines take about 8 bytes, a guess that saves regrowing
+    // the vectors several times
+    size_t expected = dataset.file.size() / 8;
+    dataset.keys.reserve(expected);
+    dataset.values.reserve(expected);
+    parseDataset(dataset.file.begin(), dataset.file.end(),
+     dataset.keys, dataset.values);
+    return dataset;
+}
+
+/*
+    * Load many dataset files at once, one thread per file
+    * @param paths files to load
+    * @return parsed datasets in the order of paths
+    * @throws std::runtime_error if any file cannot be opened or mapped
+*/
+inline std::vector<Dataset> loadDatasets(const std::vector<std::string>& paths) {
+    std::vector<std::optional<Dataset>> loaded(paths.size());
+    std::vector<std::string> errors(paths.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        workers.emplace_back([&, i]() {
+            try {
+                loaded[i].emplace(loadDataset(paths[i]));
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::vector<Dataset> datasets;
+    datasets.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!errors[i].empty())
+            throw std::runtime_error(errors[i]);
+        datasets.push_back(std::move(*loaded[i]));
+    }
+    return datasets;
+}
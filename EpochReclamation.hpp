@@ -0,0 +1,220 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    * Epoch-based reclamation for the lock-free tables. A thread pins the
+    * global epoch with an EpochGuard for the length of one operation, and
+    * memory it unlinks meanwhile is retired into one of three bags of its
+    * own, picked by the pinned epoch. The epoch only moves on once every
+    * pinned thread has seen the current one, so when a thread pins an
+    * epoch three past that of a bag, no thread can still hold a pointer
+    * retired into it and the bag is freed. Memory waiting to be freed is
+    * bounded by the retires of a few epochs per thread, unless a thread
+    * stays pinned for good.
+    *
+    * Every thread owns one record of a single process-wide domain, handed
+    * to the next thread when it exits, together with anything still in
+    * its bags.
+*/
+
+// Retires per bag between two attempts to move the epoch on
+constexpr size_t EPOCH_ADVANCE_INTERVAL = 64;
+
+/*
+    * Pinned epoch and retired memory of one thread
+*/
+struct EpochRecord {
+    // Object to free, with the function freeing it
+    struct Retired {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::atomic<uint64_t> pinned{0};  // (epoch << 1) | 1 while pinned
+    std::atomic<bool> taken{true};
+    EpochRecord* next = nullptr;
+    unsigned depth = 0;  // nested guards of the owning thread
+    std::vector<Retired> bags[3];
+    uint64_t bagEpochs[3] = {0, 0, 0};
+
+    /*
+        * Free every object of a bag
+        * @param bag bag index
+    */
+    void freeBag(size_t bag) {
+        for (const Retired& retired : bags[bag]) {
+            retired.destroy(retired.object);
+        }
+        bags[bag].clear();
+    }
+};
+
+/*
+    * Global epoch and the records of every thread that ever pinned it
+*/
+class EpochDomain {
+ private:
+    std::atomic<uint64_t> epoch{3};
+    std::atomic<EpochRecord*> records{nullptr};
+
+    EpochDomain() = default;
+
+ public:
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /*
+        * Take a record left by an exited thread or add a new one
+        * @return record owned by the calling thread
+    */
+    EpochRecord* acquire() {
+        for (EpochRecord* record = records.load(std::memory_order_acquire);
+         record; record = record->next) {
+            bool expected = false;
+            if (!record->taken.load(std::memory_order_relaxed)
+             && record->taken.compare_exchange_strong(expected, true,
+              std::memory_order_acquire))
+                return record;
+        }
+        EpochRecord* record = new EpochRecord();
+        record->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(record->next, record,
+         std::memory_order_release, std::memory_order_relaxed)) {}
+        return record;
+    }
+
+    /*
+        * Give a record up for the next thread, its bags included
+        * @param record record of the exiting thread
+    */
+    void release(EpochRecord* record) {
+        record->taken.store(false, std::memory_order_release);
+    }
+
+    /*
+        * Pin the current epoch, freeing the bag last used three or more
+        * epochs ago
+        * @param record record of the calling thread
+    */
+    void pin(EpochRecord* record) {
+        if (record->depth++ != 0)
+            return;
+        uint64_t current;
+        // Re-read after publishing, so the epoch cannot have moved on
+        // past an announcement no advancing thread saw
+        do {
+            current = epoch.load();
+            record->pinned.store((current << 1) | 1);
+        } while (epoch.load() != current);
+        size_t bag = current % 3;
+        if (record->bagEpochs[bag] != current) {
+            record->freeBag(bag);
+            record->bagEpochs[bag] = current;
+        }
+    }
+
+    /*
+        * End the pin of the outermost guard
+        * @param record record of the calling thread
+    */
+    void unpin(EpochRecord* record) {
+        if (--record->depth == 0)
+            record->pinned.store(0, std::memory_order_release);
+    }
+
+    /*
+        * Hand an unlinked object over to be freed once no pinned thread
+        * can still read it. The calling thread must be pinned.
+        * @param record record of the calling thread
+        * @param object object to free
+        * @param destroy function freeing it
+    */
+    void retire(EpochRecord* record, void* object, void (*destroy)(void*)) {
+        uint64_t current = record->pinned.load(std::memory_order_relaxed) >> 1;
+        std::vector<EpochRecord::Retired>& bag = record->bags[current % 3];
+        bag.push_back({object, destroy});
+        if (bag.size() % EPOCH_ADVANCE_INTERVAL == 0)
+            tryAdvance();
+    }
+
+    /*
+        * Move the epoch on if every pinned thread has seen the current one
+        * @return true if the epoch moved on
+    */
+    bool tryAdvance() {
+        uint64_t current = epoch.load();
+        for (EpochRecord* record = records.load(std::memory_order_acquire);
+         record; record = record->next) {
+            uint64_t pinned = record->pinned.load();
+            if ((pinned & 1) && (pinned >> 1) != current)
+                return false;
+        }
+        return epoch.compare_exchange_strong(current, current + 1);
+    }
+
+    /*
+        * Free what is left in the bags at exit, when no thread runs
+    */
+    ~EpochDomain() {
+        EpochRecord* record = records.load();
+        while (record) {
+            EpochRecord* next = record->next;
+            for (size_t bag = 0; bag < 3; ++bag) {
+                record->freeBag(bag);
+            }
+            delete record;
+            record = next;
+        }
+    }
+};
+
+/*
+    * Record of the calling thread, released when the thread exits
+    * @return record
+*/
+inline EpochRecord* threadEpochRecord() {
+    struct Owner {
+        EpochRecord* record;
+        Owner() : record(EpochDomain::instance().acquire()) {}
+        ~Owner() { EpochDomain::instance().release(record); }
+    };
+    thread_local Owner owner;
+    return owner.record;
+}
+
+/*
+    * Pins the epoch for its lifetime. Pointers read from a lock-free table
+    * stay valid until the guard is destroyed.
+*/
+class EpochGuard {
+ private:
+    EpochRecord* record;
+
+ public:
+    EpochGuard() : record(threadEpochRecord()) {
+        EpochDomain::instance().pin(record);
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() { EpochDomain::instance().unpin(record); }
+
+    /*
+        * Free an object once no pinned thread can still read it
+        * @param object object unlinked while this guard was alive
+    */
+    template <typename T>
+    void retire(T* object) {
+        EpochDomain::instance().retire(record, object,
+         [](void* p) { delete static_cast<T*>(p); });
+    }
+};
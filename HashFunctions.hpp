@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/*
+    * Hash policies. Every table takes one as its `Hash` template parameter
+    * and reduces the 64-bit result to a slot with a mask over a
+    * power-of-two table, so only the low bits have to be well mixed.
+    * IdentityHash and FibonacciHash take integer keys only; WyMixHash also
+    * hashes strings and pairs of hashable keys. A policy defining
+    * `is_transparent` hashes other types equal to its keys the same way,
+    * and tables then accept those types for lookups.
+*/
+
+/*
+    * Identity hash, the key itself. Reproduces the old `key % tableSize`
+    * behaviour on power-of-two tables, clustering included.
+*/
+template <typename K>
+struct IdentityHash {
+    uint64_t operator()(const K& key) const {
+        return static_cast<uint64_t>(key);
+    }
+};
+
+/*
+    * Fibonacci multiply-shift hash: one multiplication by 2^64 / phi,
+    * with the well mixed high half folded into the low bits
+*/
+template <typename K>
+struct FibonacciHash {
+    uint64_t operator()(const K& key) const {
+        uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 32);
+    }
+};
+
+/*
+    * Mixing step of wyhash: 64x64->128 bit multiplication, folding both
+    * halves of the product together
+    * @param a first factor
+    * @param b second factor
+    * @return folded product
+*/
+inline uint64_t wyMix(uint64_t a, uint64_t b) {
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product)
+     ^ static_cast<uint64_t>(product >> 64);
+}
+
+/*
+    * wyhash-style hash of a byte string, one multiplication per eight
+    * bytes, so strings of up to eight bytes take a single one
+    * @param data first byte
+    * @param length number of bytes
+    * @return hash
+*/
+inline uint64_t hashBytes(const char* data, size_t length) {
+    uint64_t seed = 0xa0761d6478bd642full ^ length;
+    size_t i = 0;
+    for (; i + 8 < length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        seed = wyMix(word ^ 0xe7037ed1a0b428dbull,
+         seed ^ 0x8ebc6af09c88c6e3ull);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, length - i);
+    return wyMix(tail ^ 0xe7037ed1a0b428dbull, seed ^ 0x8ebc6af09c88c6e3ull);
+}
+
+/*
+    * wyhash-style finalizer: the key multiplied with a secret
+*/
+template <typename K>
+struct WyMixHash {
+    uint64_t operator()(const K& key) const {
+        return wyMix(static_cast<uint64_t>(key) ^ 0xa0761d6478bd642full,
+         0xe7037ed1a0b428dbull);
+    }
+};
+
+/*
+    * Strings hashed by their bytes. Transparent, so a table with
+    * std::string keys can be searched by std::string_view or a C string
+    * without building a std::string.
+*/
+template <>
+struct WyMixHash<std::string> {
+    using is_transparent = void;
+
+    uint64_t operator()(std::string_view key) const {
+        return hashBytes(key.data(), key.size());
+    }
+};
+
+template <>
+struct WyMixHash<std::string_view> : WyMixHash<std::string> {};
+
+/*
+    * Composite keys: the hashes of both members mixed together
+*/
+template <typename A, typename B>
+struct WyMixHash<std::pair<A, B>> {
+    uint64_t operator()(const std::pair<A, B>& key) const {
+        return wyMix(WyMixHash<A>()(key.first) ^ 0xe7037ed1a0b428dbull,
+         WyMixHash<B>()(key.second) ^ 0x8ebc6af09c88c6e3ull);
+    }
+};
+
+/*
+    * Derive a second, independent hash from a first one with the murmur3
+    * finalizer, for tables that need two positions per key
+    * @param h hash of the key
+    * @return remixed hash
+*/
+inline uint64_t remixHash(uint64_t h) {
+    h ^= 0x9E3779B97F4A7C15ull;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+    * Round a requested table size up to a power of two
+    * @param size requested size
+    * @param minimum smallest size to return, a power of two
+    * @return smallest power of two not below size and minimum
+*/
+inline size_t roundUpToPowerOfTwo(size_t size, size_t minimum = 1) {
+    size_t result = minimum;
+    while (result < size) {
+        result *= 2;
+    }
+    return result;
+}
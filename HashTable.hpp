@@ -1,5 +1,27 @@
 #pragma once
 #include <iostream>
+#include <utility>
+#include "./TableStats.hpp"
+
+/*
+    * Print a key for print(), keys() and values(). Pairs, the composite
+    * keys the hash policies support, print as (first, second).
+    * @param output stream to print to
+    * @param key key to print
+*/
+template <typename K>
+void printKey(std::ostream& output, const K& key) {
+    output << key;
+}
+
+template <typename A, typename B>
+void printKey(std::ostream& output, const std::pair<A, B>& key) {
+    output << "(";
+    printKey(output, key.first);
+    output << ", ";
+    printKey(output, key.second);
+    output << ")";
+}
 
 template <typename K, typename V>
 class HashTable {
@@ -14,5 +36,100 @@ class HashTable {
     virtual void values() = 0;
     virtual float getLoadFactor() = 0;
     virtual void print() = 0;
+
+    /*
+        * Gather fill, memory and probe statistics by walking the table
+        * @return statistics, see TableStats
+    */
+    virtual TableStats stats() = 0;
+
+    /*
+        * Check many keys at once. Tables override this to hash the whole
+        * batch first and prefetch every slot before comparing keys.
+        * @param keys keys to check
+        * @param count number of keys
+        * @param results set to whether each key exists
+    */
+    virtual void existsBatch(const K* keys, size_t count, bool* results) {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = exists(keys[i]);
+        }
+    }
+
+    /*
+        * Search for many keys at once, missing keys do not throw
+        * @param keys keys to search for
+        * @param count number of keys
+        * @param values set to the value of each key that was found
+        * @param found set to whether each key was found
+        * @return number of keys found
+    */
+    virtual size_t searchBatch(const K* keys, size_t count,
+     V* values, bool* found) {
+        size_t hits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            found[i] = exists(keys[i]);
+            if (found[i]) {
+                values[i] = search(keys[i]);
+                ++hits;
+            }
+        }
+        return hits;
+    }
+
+    /*
+        * Insert many key-value pairs at once. Tables override this to size
+        * themselves once and fill disjoint parts of the table in parallel.
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+    */
+    virtual void bulkLoad(const K* keys, const V* values, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            insert(keys[i], values[i]);
+        }
+    }
+
     virtual ~HashTable() {}
 };
+
+/*
+    * Puts a table with a non-virtual interface behind HashTable. The
+    * adapter derives from the table, so its own methods stay reachable,
+    * and is final, so calls made through the adapter type itself are
+    * still resolved at compile time. Lookups by other key types the table
+    * offers, such as std::string_view, stay reachable through it too.
+*/
+template <typename Table, typename K, typename V>
+class HashTableAdapter final : public HashTable<K, V>, public Table {
+ public:
+    using Table::Table;
+    using Table::search;
+    using Table::remove;
+    using Table::exists;
+
+    void insert(const K& key, const V& value) override {
+        Table::insert(key, value);
+    }
+    V search(const K& key) override { return Table::search(key); }
+    void remove(const K& key) override { Table::remove(key); }
+    bool exists(const K& key) override { return Table::exists(key); }
+    size_t size() override { return Table::size(); }
+    bool empty() override { return Table::empty(); }
+    void keys() override { Table::keys(); }
+    void values() override { Table::values(); }
+    float getLoadFactor() override { return Table::getLoadFactor(); }
+    void print() override { Table::print(); }
+    TableStats stats() override { return Table::stats(); }
+
+    void existsBatch(const K* keys, size_t count, bool* results) override {
+        Table::existsBatch(keys, count, results);
+    }
+    size_t searchBatch(const K* keys, size_t count,
+     V* values, bool* found) override {
+        return Table::searchBatch(keys, count, values, found);
+    }
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        Table::bulkLoad(keys, values, count);
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// How a mapping will be read, passed on to the kernel as madvise hints
+enum class MappedAccess {
+    Sequential,  // one pass front to back: read ahead, drop pages behind
+    Random,  // point lookups: read only the pages touched, keep them
+};
+
+/*
+    * Read-only memory mapping of a whole file
+*/
+class MappedFile {
+ private:
+    const char* data_;
+    size_t size_;
+
+ public:
+    /*
+        * Constructor, maps the file
+        * @param path file to map
+        * @param access how the mapping will be read
+        * @throws std::runtime_error if the file cannot be opened or mapped
+    */
+    MappedFile(const std::string& path, MappedAccess access)
+        : data_(nullptr), size_(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0) {
+            void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            if (access == MappedAccess::Sequential) {
+                ::madvise(mapping, size_, MADV_SEQUENTIAL);
+                ::madvise(mapping, size_, MADV_WILLNEED);
+            } else {
+                ::madvise(mapping, size_, MADV_RANDOM);
+            }
+            data_ = static_cast<const char*>(mapping);
+        }
+        ::close(fd);  // the mapping keeps the file alive
+    }
+
+    /*
+        * Move constructor
+        * @param other mapping to take over
+    */
+    MappedFile(MappedFile&& other) noexcept
+        : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+    /*
+        * Destructor, unmaps the file
+    */
+    ~MappedFile() {
+        if (data_)
+            ::munmap(const_cast<char*>(data_), size_);
+    }
+};
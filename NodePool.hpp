@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "./BSTNode.hpp"
+
+/*
+    * Slab allocator for BSTNode. Nodes are addressed by 32-bit index and
+    * carved out of fixed-size slabs, so they never move and sit next to
+    * each other in allocation order. Released nodes go on a free list
+    * linked through their `left` index and are handed out again first.
+*/
+template <typename K, typename V>
+class NodePool {
+ private:
+    static constexpr uint32_t SLAB_BITS = 12;
+    static constexpr uint32_t SLAB_SIZE = 1u << SLAB_BITS;
+
+    std::vector<BSTNode<K, V>*> slabs;
+    uint32_t used;      // nodes ever handed out from the slabs
+    uint32_t freeList;  // first released node or NIL
+    size_t live;
+
+ public:
+    static constexpr uint32_t NIL = BSTNode<K, V>::NIL;
+
+    /*
+        * Constructor of an empty pool, slabs are allocated on demand
+    */
+    NodePool() : used(0), freeList(NIL), live(0) {}
+
+    /*
+        * Copy constructor, node indices stay valid in the copy
+        * @param other pool to copy
+    */
+    NodePool(const NodePool& other)
+        : used(other.used), freeList(other.freeList), live(other.live) {
+        for (BSTNode<K, V>* slab : other.slabs) {
+            BSTNode<K, V>* copy = new BSTNode<K, V>[SLAB_SIZE];
+            for (uint32_t i = 0; i < SLAB_SIZE; ++i) {
+                copy[i] = slab[i];
+            }
+            slabs.push_back(copy);
+        }
+    }
+
+    NodePool& operator=(const NodePool&) = delete;
+
+    BSTNode<K, V>& operator[](uint32_t i) {
+        return slabs[i >> SLAB_BITS][i & (SLAB_SIZE - 1)];
+    }
+    const BSTNode<K, V>& operator[](uint32_t i) const {
+        return slabs[i >> SLAB_BITS][i & (SLAB_SIZE - 1)];
+    }
+
+    /*
+        * Take a node from the free list or the current slab
+        * @param key key of the new node
+        * @param value value of the new node
+        * @return index of the node
+    */
+    uint32_t allocate(const K& key, const V& value) {
+        uint32_t index;
+        if (freeList != NIL) {
+            index = freeList;
+            freeList = (*this)[index].left;
+        } else {
+            if (used == slabs.size() * SLAB_SIZE) {
+                slabs.push_back(new BSTNode<K, V>[SLAB_SIZE]);
+            }
+            index = used++;
+        }
+        construct(index, key, value);
+        ++live;
+        return index;
+    }
+
+    /*
+        * Set up a node taken with reserve() as a fresh leaf
+        * @param index index of the node
+        * @param key key of the node
+        * @param value value of the node
+    */
+    void construct(uint32_t index, const K& key, const V& value) {
+        BSTNode<K, V>& node = (*this)[index];
+        node.key = key;
+        node.value = value;
+        node.left = NIL;
+        node.right = NIL;
+        node.height = 1;
+    }
+
+    /*
+        * Take count consecutive nodes from the slabs at once, so threads
+        * can set up nodes of disjoint ranges without touching the pool.
+        * Reserved nodes count as in use until they are released.
+        * @param count number of nodes
+        * @return index of the first node
+    */
+    uint32_t reserve(size_t count) {
+        uint32_t first = used;
+        while (slabs.size() * SLAB_SIZE < used + count) {
+            slabs.push_back(new BSTNode<K, V>[SLAB_SIZE]);
+        }
+        used += static_cast<uint32_t>(count);
+        live += count;
+        return first;
+    }
+
+    /*
+        * Return node to the free list
+        * @param index index of the node
+    */
+    void release(uint32_t index) {
+        BSTNode<K, V>& node = (*this)[index];
+        node.value = V();  // drop resources held by the value early
+        node.left = freeList;
+        freeList = index;
+        --live;
+    }
+
+    /*
+        * Forget every node at once, keeping the slabs for reuse
+    */
+    void clear() {
+        used = 0;
+        freeList = NIL;
+        live = 0;
+    }
+
+    /*
+        * Get number of nodes in use
+        * @return number of nodes
+    */
+    size_t size() const {
+        return live;
+    }
+
+    /*
+        * Get memory held by the slabs, released nodes included
+        * @return bytes
+    */
+    size_t bytes() const {
+        return slabs.size() * SLAB_SIZE * sizeof(BSTNode<K, V>)
+         + slabs.capacity() * sizeof(BSTNode<K, V>*);
+    }
+
+    /*
+        * Destructor, frees whole slabs instead of single nodes
+    */
+    ~NodePool() {
+        for (BSTNode<K, V>* slab : slabs) {
+            delete[] slab;
+        }
+    }
+};
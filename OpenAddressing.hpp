@@ -1,37 +1,524 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 #include <utility>  // for std::pair
+#include <vector>
 #include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+#include "./SlotLayout.hpp"
+#include "./ProbeSequence.hpp"
+#include "./ParallelBuild.hpp"
+#include "./Snapshot.hpp"
 
-template <typename K, typename V>
-class OpenAddressing : public HashTable<K, V> {
+/*
+    * Open addressing without virtual dispatch. The probe sequence is the
+    * Probe policy, so a compile-time policy leaves no branch on the
+    * probing type in the probe loops. Callers that know the table type
+    * use it directly; OpenAddressing wraps it in the HashTable interface.
+    * Slot states are kept by the Layout, so every value of K can be stored
+    * and any key with == and a Hash policy works, std::string included.
+*/
+template <typename K, typename V, typename Layout = PairLayout<K, V>,
+ typename Hash = WyMixHash<K>, typename Probe = RuntimeProbe>
+class OpenAddressingTable {
  private:
-    std::pair<K, V>* table;
-    size_t tableSize;
+    Layout table;  // power-of-two number of slots
+    uint32_t* distances;  // probe distance per slot of `table`, Robin Hood only
     size_t numElements;
-    int probingType;
+    size_t numTombstones;  // deleted slots in `table`
+    Probe probe;
+    float maxLoadFactor;
+    bool incrementalRehash;
+    Hash hasher;
 
-    static constexpr K EMPTY_KEY = -1;
-    static constexpr K DELETED_KEY = -2;
+    // Table being drained into `table` while an incremental rehash runs,
+    // without slots otherwise. Slots below migrateIndex were already moved.
+    Layout oldTable;
+    size_t migrateIndex;
+
+    static constexpr size_t REHASH_STEP = 8;  // old slots moved per operation
+    static constexpr size_t BATCH_SIZE = 16;  // lookups in flight per batch
 
     /*
-        * Hash function with linear probing for collision resolution
-        * @param key key to hash
+        * Probe sequence for collision resolution over a power-of-two table
+        * @param h hash of the key
         * @param i number of iteration
-        * @return hashed key
+        * @param mask size of the table being probed minus one
+        * @return slot index
+    */
+    size_t hash(uint64_t h, size_t i, size_t mask) const {
+        return probe(h, i, mask);
+    }
+
+    /*
+        * Check if probing type falls back to linear probing
+        * @return true for linear probing
+    */
+    bool isLinearProbing() const {
+        return probe.isLinear();
+    }
+
+    /*
+        * Check if Robin Hood hashing is used
+        * @return true if slots keep their probe distance
+    */
+    bool isRobinHood() const {
+        return probe.isRobinHood();
+    }
+
+    /*
+        * Allocate probe distance array for a table
+        * @param slotCount number of slots
+        * @return allocated array, nullptr unless Robin Hood hashing is used
+    */
+    uint32_t* allocateDistances(size_t slotCount) const {
+        return isRobinHood() ? new uint32_t[slotCount]() : nullptr;
+    }
+
+    /*
+        * Put key-value pair into first free slot of its probe sequence
+        * @param slots table to insert into
+        * @param dist probe distances of that table, nullptr if not tracked
+        * @param key key to insert
+        * @param value value to insert
+        * @return false if the whole probe sequence is occupied
+    */
+    bool place(Layout& slots, uint32_t* dist, const K& key, const V& value) {
+        if (dist)
+            return placeRobinHood(slots, dist, key, value);
+        size_t slotCount = slots.capacity();
+        uint64_t h = hasher(key);
+        for (size_t i = 0; i < slotCount; ++i) {
+            size_t index = hash(h, i, slotCount - 1);
+            if (!slots.occupied(index)) {
+                if (slots.state(index) == SlotState::Deleted)
+                    --numTombstones;  // only `table` has counted tombstones
+                slots.set(index, key, value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+        * Robin Hood insertion: the new entry takes the first slot whose
+        * entry is closer to its home than the new one would be, and the rest
+        * of the cluster up to the next free slot shifts forward by one.
+        * Nothing moves unless a free slot exists, so a full table loses no data.
+        * @param slots table to insert into
+        * @param dist probe distances of that table
+        * @param key key to insert
+        * @param value value to insert
+        * @return false if the table is full
+    */
+    bool placeRobinHood(Layout& slots, uint32_t* dist,
+     const K& key, const V& value) {
+        size_t slotCount = slots.capacity();
+        size_t mask = slotCount - 1;
+        size_t index = hasher(key) & mask;
+        uint32_t distance = 0;
+        while (distance < slotCount && slots.occupied(index)
+         && dist[index] >= distance) {
+            index = (index + 1) & mask;
+            ++distance;
+        }
+        if (distance == slotCount)
+            return false;
+        size_t free = index;
+        size_t shifted = 0;
+        while (slots.occupied(free)) {
+            free = (free + 1) & mask;
+            if (++shifted == slotCount)
+                return false;
+        }
+        while (free != index) {
+            size_t prev = (free + mask) & mask;
+            slots.moveSlot(free, prev);
+            dist[free] = dist[prev] + 1;
+            free = prev;
+        }
+        slots.set(index, key, value);
+        dist[index] = distance;
+        return true;
+    }
+
+    /*
+        * Robin Hood insertion that neither probes nor shifts entries past
+        * slot `end`, so threads can fill disjoint ranges of `table`
+        * @param key key to insert
+        * @param value value to insert
+        * @param home home slot of the key
+        * @param end first slot after the range holding home
+        * @return false if the range has no free slot left for the key
     */
-    size_t hash(const K& key, int i) const {
-        const int C = 1;  // Adjust this value as needed
-        int hashOne = key % tableSize;
-        int hashTwo = (key * 2) % tableSize;
-        switch (probingType) {
-            case 0:
-                return (hashOne + i * C) % tableSize;  // Linear probing
-            case 1:
-                return (hashOne + i * i * C) % tableSize;  // Quadratic probing
-            case 2:
-                return (hashOne + i * hashTwo) % tableSize;  // Double hashing
-            default:
-                return (hashOne + i * C) % tableSize;  // Linear probing
+    bool placeRobinHoodInRange(const K& key, const V& value,
+     size_t home, size_t end) {
+        size_t index = home;
+        while (index < end && table.occupied(index)
+         && distances[index] >= index - home) {
+            ++index;
+        }
+        size_t free = index;
+        while (free < end && table.occupied(free)) {
+            ++free;
+        }
+        if (free == end)
+            return false;
+        for (; free != index; --free) {
+            table.moveSlot(free, free - 1);
+            distances[free] = distances[free - 1] + 1;
+        }
+        table.set(index, key, value);
+        distances[index] = static_cast<uint32_t>(index - home);
+        return true;
+    }
+
+    /*
+        * Find slot holding key. Only slot states and the keys of full
+        * slots are read while probing.
+        * @param slots table to search
+        * @param dist probe distances of that table, nullptr if not tracked
+        * @param key key to search for, a K or a type Hash is transparent for
+        * @param h hash of the key
+        * @return slot index or slots.capacity() if key not found
+    */
+    template <typename Q>
+    size_t findSlot(const Layout& slots, const uint32_t* dist,
+     const Q& key, uint64_t h) const {
+        size_t slotCount = slots.capacity();
+        if (dist) {
+            // Robin Hood: stop once the key would have displaced the entry
+            size_t index = h & (slotCount - 1);
+            for (uint32_t distance = 0; slots.occupied(index)
+             && dist[index] >= distance; ++distance) {
+                if (slots.key(index) == key)
+                    return index;
+                index = (index + 1) & (slotCount - 1);
+            }
+            return slotCount;
+        }
+        for (size_t i = 0; i < slotCount; ++i) {
+            size_t index = hash(h, i, slotCount - 1);
+            SlotState state = slots.state(index);
+            if (state == SlotState::Full && slots.key(index) == key)
+                return index;
+            else if (state == SlotState::Empty)
+                break;
+        }
+        return slotCount;
+    }
+
+    /*
+        * Find slot holding key in current or draining table
+        * @param key key to search for
+        * @param h hash of the key
+        * @param index set to the slot index if key is found
+        * @return table holding key or nullptr if key not found
+    */
+    template <typename Q>
+    Layout* find(const Q& key, uint64_t h, size_t& index) {
+        index = findSlot(table, distances, key, h);
+        if (index != table.capacity())
+            return &table;
+        if (oldTable.capacity() == 0)
+            return nullptr;
+        index = findSlot(oldTable, nullptr, key, h);
+        return index != oldTable.capacity() ? &oldTable : nullptr;
+    }
+
+    /*
+        * Find slot holding key in current or draining table
+        * @param key key to search for
+        * @param index set to the slot index if key is found
+        * @return table holding key or nullptr if key not found
+    */
+    template <typename Q>
+    Layout* find(const Q& key, size_t& index) {
+        return find(key, hasher(key), index);
+    }
+
+    /*
+        * Search for key, advancing a pending migration
+        * @param key key to search for, a K or a type Hash is transparent for
+        * @return value associated with key
+        * @throws std::range_error if key not found
+    */
+    template <typename Q>
+    V searchKey(const Q& key) {
+        migrate(REHASH_STEP);
+        size_t index;
+        const Layout* slots = find(key, index);
+        if (slots)
+            return slots->value(index);
+        throw std::range_error("Key not found");
+    }
+
+    /*
+        * Remove key, advancing a pending migration
+        * @param key key to remove, a K or a type Hash is transparent for
+        * @throws std::range_error if key not found
+    */
+    template <typename Q>
+    void removeKey(const Q& key) {
+        migrate(REHASH_STEP);
+        size_t index;
+        Layout* slots = find(key, index);
+        if (!slots)
+            throw std::range_error("Key not found");
+        --numElements;
+        bool inTable = slots == &table;
+        if (inTable && isLinearProbing()) {
+            backwardShiftDelete(index);
+            return;
+        }
+        slots->clear(index, SlotState::Deleted);  // Mark as deleted
+        // Purge once tombstones take up half of the free slots, so misses
+        // always reach an empty slot quickly
+        if (inTable
+         && ++numTombstones > (table.capacity() - numElements) / 2) {
+            purgeTombstones();
+        }
+    }
+
+    /*
+        * Hash a batch of keys and prefetch the first slot each one probes
+        * @param keys keys of the batch
+        * @param count number of keys, at most BATCH_SIZE
+        * @param hashes set to the hash of each key
+    */
+    void prefetchBatch(const K* keys, size_t count, uint64_t* hashes) const {
+        size_t mask = table.capacity() - 1;
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hasher(keys[i]);
+            size_t index = hash(hashes[i], 0, mask);
+            table.prefetch(index);
+            if (distances)
+                __builtin_prefetch(&distances[index]);
+        }
+    }
+
+    /*
+        * Move up to `steps` slots of the draining table into the new one.
+        * Moved slots become tombstones, so probe chains in the old table
+        * that pass through them stay intact until it is freed.
+        * @param steps number of old slots to visit
+    */
+    void migrate(size_t steps) {
+        if (oldTable.capacity() == 0) return;
+        for (; steps > 0 && migrateIndex < oldTable.capacity(); --steps) {
+            size_t index = migrateIndex++;
+            if (oldTable.occupied(index)) {
+                while (!place(table, distances,
+                 oldTable.key(index), oldTable.value(index))) {
+                    // Only possible for probe sequences that skip slots
+                    rebuild(table.capacity() * 2);
+                }
+                oldTable.clear(index, SlotState::Deleted);
+            }
+        }
+        if (migrateIndex == oldTable.capacity()) {
+            oldTable = Layout();
+            migrateIndex = 0;
+        }
+    }
+
+    /*
+        * Rehash the current table into a new one at once, leaving any
+        * draining table untouched
+        * @param newSize size of the new table
+    */
+    void rebuild(size_t newSize) {
+        Layout slots(newSize);
+        uint32_t* dist = allocateDistances(newSize);
+        const Layout& current = table;
+        for (size_t i = 0; i < current.capacity(); ++i) {
+            if (current.occupied(i)
+             && !place(slots, dist, current.key(i), current.value(i))) {
+                delete[] dist;
+                rebuild(newSize * 2);
+                return;
+            }
+        }
+        table.swap(slots);
+        delete[] distances;
+        distances = dist;
+        numTombstones = 0;
+    }
+
+    /*
+        * Remove entry at index of a linear probing table by shifting the
+        * following entries of its cluster back, so no tombstone is left
+        * @param index slot to clear
+    */
+    void backwardShiftDelete(size_t index) {
+        size_t mask = table.capacity() - 1;
+        size_t hole = index;
+        size_t next = (hole + 1) & mask;
+        if (distances) {
+            // Robin Hood keeps clusters sorted by home slot, so every entry
+            // away from home moves back by exactly one
+            while (table.occupied(next) && distances[next] > 0) {
+                table.moveSlot(hole, next);
+                distances[hole] = distances[next] - 1;
+                hole = next;
+                next = (next + 1) & mask;
+            }
+            table.clear(hole, SlotState::Empty);
+            return;
+        }
+        while (table.occupied(next)) {
+            size_t home = hasher(table.key(next)) & mask;
+            // Entry may fill the hole unless its home lies in (hole, next]
+            bool homeBetween = hole <= next
+             ? (home > hole && home <= next)
+             : (home > hole || home <= next);
+            if (!homeBetween) {
+                table.moveSlot(hole, next);
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        table.clear(hole, SlotState::Empty);
+    }
+
+    /*
+        * Drop all tombstones of the current table without reallocating it.
+        * Live entries are re-placed one by one: each takes the first slot of
+        * its probe sequence that is empty or still waiting to be re-placed,
+        * evicting the waiting entry which is then placed in turn.
+    */
+    void purgeTombstones() {
+        size_t tableSize = table.capacity();
+        std::vector<bool> pending(tableSize, false);
+        for (size_t i = 0; i < tableSize; ++i) {
+            if (table.occupied(i)) {
+                pending[i] = true;
+            } else {
+                table.clear(i, SlotState::Empty);
+            }
+        }
+        numTombstones = 0;
+        std::vector<std::pair<K, V>> homeless;
+        for (size_t i = 0; i < tableSize; ++i) {
+            if (!pending[i]) continue;
+            std::pair<K, V> entry(std::move(table.key(i)),
+             std::move(table.value(i)));
+            table.clear(i, SlotState::Empty);
+            pending[i] = false;
+            bool placing = true;
+            while (placing) {
+                uint64_t h = hasher(entry.first);
+                size_t probe = 0;
+                size_t index = hash(h, probe, tableSize - 1);
+                while (probe < tableSize
+                 && table.occupied(index) && !pending[index]) {
+                    index = hash(h, ++probe, tableSize - 1);
+                }
+                if (probe == tableSize) {
+                    homeless.push_back(std::move(entry));
+                    placing = false;
+                } else if (pending[index]) {
+                    std::swap(entry.first, table.key(index));
+                    table.swapValue(index, entry.second);
+                    pending[index] = false;
+                } else {
+                    table.set(index, entry.first, entry.second);
+                    placing = false;
+                }
+            }
+        }
+        // Probe sequences that skip slots may leave an entry without a home
+        for (std::pair<K, V>& entry : homeless) {
+            while (!place(table, distances, entry.first, entry.second)) {
+                rebuild(table.capacity() * 2);
+            }
+        }
+    }
+
+    /*
+        * Finish pending migration and start a new one into a bigger table
+        * @param newSize size of the new table
+    */
+    void growTo(size_t newSize) {
+        if (oldTable.capacity() != 0)
+            migrate(oldTable.capacity());
+        oldTable = Layout(newSize);
+        oldTable.swap(table);
+        migrateIndex = 0;
+        delete[] distances;
+        distances = allocateDistances(newSize);
+        numTombstones = 0;
+        if (!incrementalRehash)
+            migrate(oldTable.capacity());
+    }
+
+    /*
+        * Fill an empty table of linear probe sequences in parallel. Entries
+        * are grouped by the range of slots their home lies in and every
+        * range is filled by one thread, probing and shifting only inside
+        * the range. Entries running past the end of their range are placed
+        * one by one afterwards. Layouts without CONCURRENT_SET are filled
+        * the same way on the calling thread.
+        * @param keys keys to insert
+        * @param values values to insert
+        * @param count number of pairs
+        * @param slotCount size of the new table
+    */
+    void fillParallel(const K* keys, const V* values, size_t count,
+     size_t slotCount) {
+        if (slotCount != table.capacity() || numTombstones != 0) {
+            Layout slots(slotCount);
+            table.swap(slots);
+            delete[] distances;
+            distances = allocateDistances(slotCount);
+            numTombstones = 0;
+        }
+
+        size_t mask = slotCount - 1;
+        unsigned threads =
+         Layout::CONCURRENT_SET ? buildThreadCount(count) : 1;
+        // Ranges of at least 1024 slots keep spills into the next one rare
+        size_t parts = buildPartCount(threads,
+         std::max<size_t>(slotCount / 1024, 1));
+        size_t rangeSize = slotCount / parts;
+        std::vector<size_t> order;
+        std::vector<size_t> offsets = partitionEntries(count, parts, threads,
+         [&](size_t i) { return (hasher(keys[i]) & mask) / rangeSize; },
+         order);
+        std::vector<std::vector<size_t>> spilled(parts);
+        parallelFor(parts, threads, [&](size_t part) {
+            size_t end = (part + 1) * rangeSize;
+            for (size_t j = offsets[part]; j < offsets[part + 1]; ++j) {
+                const K& key = keys[order[j]];
+                const V& value = values[order[j]];
+                size_t home = hasher(key) & mask;
+                if (distances) {
+                    if (!placeRobinHoodInRange(key, value, home, end))
+                        spilled[part].push_back(order[j]);
+                    continue;
+                }
+                size_t index = home;
+                while (index < end && table.occupied(index)) {
+                    ++index;
+                }
+                if (index == end) {
+                    spilled[part].push_back(order[j]);
+                    continue;
+                }
+                table.set(index, key, value);
+            }
+        });
+        numElements = count;
+        for (const std::vector<size_t>& entries : spilled) {
+            numElements -= entries.size();
+        }
+        for (const std::vector<size_t>& entries : spilled) {
+            for (size_t i : entries) {
+                insert(keys[i], values[i]);
+            }
         }
     }
 
@@ -40,56 +527,116 @@ class OpenAddressing : public HashTable<K, V> {
         * @return load factor
     */
     float calculateLoadFactor() const {
-        return static_cast<float>(numElements) / static_cast<float>(tableSize);
+        return static_cast<float>(numElements)
+         / static_cast<float>(table.capacity());
+    }
+
+    /*
+        * Print every occupied slot of a table
+        * @param slots table to print
+        * @param from first slot to print
+        * @param withKey print keys if true
+        * @param withValue print values if true
+    */
+    static void printSlots(const Layout& slots, size_t from,
+     bool withKey, bool withValue) {
+        for (size_t i = from; i < slots.capacity(); ++i) {
+            if (!slots.occupied(i)) continue;
+            if (withKey && withValue) {
+                std::cout << "Key: ";
+                printKey(std::cout, slots.key(i));
+                std::cout << ", Value: " << slots.value(i) << std::endl;
+            } else if (withKey) {
+                printKey(std::cout, slots.key(i));
+                std::cout << std::endl;
+            } else {
+                std::cout << slots.value(i) << std::endl;
+            }
+        }
     }
 
  public:
     /*
         * Constructor
-        * @param probingType type of probing to use: 
-        * 0 for linear probing, 1 for quadratic probing, 2 for double hashing
-        * @param size size of hash table
+        * @param probingType type of probing to use with RuntimeProbe:
+        * 0 for linear probing, 1 for quadratic probing, 2 for double hashing,
+        * 3 for Robin Hood hashing; compile-time Probe policies ignore it
+        * @param size initial size of hash table, rounded up to a power of two
+        * @param maxLoadFactor load factor above which the table grows
+        * @param incrementalRehash spread rehashing over subsequent
+        * operations instead of moving every element at once
     */
-    explicit OpenAddressing(int probingType, size_t size = 101) :
-     probingType(probingType), tableSize(size), numElements(0) {
-        table = new std::pair<K, V>[tableSize];
-        for (size_t i = 0; i < tableSize; ++i) {
-            table[i].first = EMPTY_KEY;
-        }
+    explicit OpenAddressingTable(int probingType, size_t size = 101,
+     float maxLoadFactor = 0.75f, bool incrementalRehash = true) :
+     table(roundUpToPowerOfTwo(size)),
+     numElements(0), numTombstones(0),
+     probe(probingType),
+     maxLoadFactor(maxLoadFactor), incrementalRehash(incrementalRehash),
+     migrateIndex(0) {
+        distances = allocateDistances(table.capacity());
     }
 
     /*
         * Copy constructor
-        * @param other OpenAddressing object to copy
+        * @param other OpenAddressingTable object to copy
     */
-    OpenAddressing(const OpenAddressing& other) {
-        probingType = other.probingType;
-        tableSize = other.tableSize;
+    OpenAddressingTable(const OpenAddressingTable& other)
+     : table(other.table), probe(other.probe), oldTable(other.oldTable) {
         numElements = other.numElements;
-        table = new std::pair<K, V>[tableSize];
-        for (size_t i = 0; i < tableSize; ++i) {
-            table[i] = other.table[i];
+        numTombstones = other.numTombstones;
+        maxLoadFactor = other.maxLoadFactor;
+        incrementalRehash = other.incrementalRehash;
+        migrateIndex = other.migrateIndex;
+        distances = allocateDistances(table.capacity());
+        if (distances) {
+            for (size_t i = 0; i < table.capacity(); ++i) {
+                distances[i] = other.distances[i];
+            }
         }
     }
 
     /*
-        * Insert key-value pair into hash table
+        * Insert key-value pair into hash table, growing it when the
+        * load factor would exceed maxLoadFactor
         * @param key key to insert
         * @param value value to insert
-        * @throws std::overflow_error if hash table is full
     */
-    void insert(const K& key, const V& value) override {
-        int i = 0;
-        size_t index;
-        while(1) {
-            index = hash(key, i);
-            if (table[index].first == EMPTY_KEY
-                || table[index].first == DELETED_KEY) {
-                table[index] = std::make_pair(key, value);
-                ++numElements;
-                return;
-            }
-            ++i;
+    void insert(const K& key, const V& value) {
+        migrate(REHASH_STEP);
+        if (static_cast<float>(numElements + 1)
+         / static_cast<float>(table.capacity()) > maxLoadFactor) {
+            growTo(table.capacity() * 2);
+        }
+        while (!place(table, distances, key, value)) {
+            growTo(table.capacity() * 2);
+        }
+        ++numElements;
+    }
+
+    /*
+        * Insert many key-value pairs at once. The table grows once to fit
+        * all of them; an empty table with a linear probe sequence is then
+        * filled in parallel, other tables take the pairs one by one.
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) {
+        if (oldTable.capacity() != 0)
+            migrate(oldTable.capacity());
+        size_t slotCount = table.capacity();
+        while (static_cast<float>(numElements + count)
+         / static_cast<float>(slotCount) > maxLoadFactor) {
+            slotCount *= 2;
+        }
+        if (numElements == 0 && isLinearProbing()) {
+            fillParallel(keys, values, count, slotCount);
+            return;
+        }
+        if (slotCount != table.capacity())
+            rebuild(slotCount);
+        for (size_t i = 0; i < count; ++i) {
+            insert(keys[i], values[i]);
         }
     }
 
@@ -99,18 +646,22 @@ class OpenAddressing : public HashTable<K, V> {
         * @return value associated with key
         * @throws std::range_error if key not found
     */
-    V search(const K& key) override {
-        int i = 0;
-        size_t index;
-        while (i < tableSize) {
-            index = hash(key, i);
-            if (table[index].first == key)
-                return table[index].second;
-            else if (table[index].first == EMPTY_KEY)
-                break;
-            ++i;
-        }
-        throw std::range_error("Key not found");
+    V search(const K& key) {
+        return searchKey(key);
+    }
+
+    /*
+        * Search for a key by another type, such as std::string_view for
+        * std::string keys, without building a K. Only available with a
+        * transparent Hash.
+        * @param key key to search for
+        * @return value associated with key
+        * @throws std::range_error if key not found
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    V search(const Q& key) {
+        return searchKey(key);
     }
 
     /*
@@ -118,21 +669,19 @@ class OpenAddressing : public HashTable<K, V> {
         * @param key key to remove
         * @throws std::range_error if key not found
     */
-    void remove(const K& key) override {
-        int i = 0;
-        size_t index;
-        while (i < tableSize) {
-            index = hash(key, i);
-            if (table[index].first == key) {
-                table[index].first = DELETED_KEY;  // Mark as deleted
-                --numElements;
-                return;
-            } else if (table[index].first == EMPTY_KEY) {
-                break;
-            }
-            ++i;
-        }
-        throw std::range_error("Key not found");
+    void remove(const K& key) {
+        removeKey(key);
+    }
+
+    /*
+        * Remove a key given by another type, see search()
+        * @param key key to remove
+        * @throws std::range_error if key not found
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    void remove(const Q& key) {
+        removeKey(key);
     }
 
     /*
@@ -140,25 +689,80 @@ class OpenAddressing : public HashTable<K, V> {
         * @param key key to check
         * @return true if key exists, false otherwise
     */
-    bool exists(const K& key) override {
-        int i = 0;
+    bool exists(const K& key) {
         size_t index;
-        while (i < tableSize) {
-            index = hash(key, i);
-            if (table[index].first == key)
-                return true;
-            else if (table[index].first == EMPTY_KEY)
-                break;
-            ++i;
+        return find(key, index) != nullptr;
+    }
+
+    /*
+        * Check if a key given by another type exists, see search()
+        * @param key key to check
+        * @return true if key exists, false otherwise
+    */
+    template <typename Q, typename H = Hash,
+     typename = typename H::is_transparent>
+    bool exists(const Q& key) {
+        size_t index;
+        return find(key, index) != nullptr;
+    }
+
+    /*
+        * Check many keys at once, prefetching the first slot of every key
+        * of a batch before probing any of them
+        * @param keys keys to check
+        * @param count number of keys
+        * @param results set to whether each key exists
+    */
+    void existsBatch(const K* keys, size_t count, bool* results) {
+        uint64_t hashes[BATCH_SIZE];
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            prefetchBatch(keys + base, n, hashes);
+            for (size_t i = 0; i < n; ++i) {
+                size_t index;
+                results[base + i] =
+                 find(keys[base + i], hashes[i], index) != nullptr;
+            }
         }
-        return false;
+    }
+
+    /*
+        * Search for many keys at once, prefetching the first slot of every
+        * key of a batch before probing any of them
+        * @param keys keys to search for
+        * @param count number of keys
+        * @param values set to the value of each key that was found
+        * @param found set to whether each key was found
+        * @return number of keys found
+    */
+    size_t searchBatch(const K* keys, size_t count,
+     V* values, bool* found) {
+        uint64_t hashes[BATCH_SIZE];
+        size_t hits = 0;
+        for (size_t base = 0; base < count; base += BATCH_SIZE) {
+            size_t n = std::min(BATCH_SIZE, count - base);
+            // Same pace as n single searches; done before prefetching
+            // since a migration step may resize the table
+            migrate(REHASH_STEP * n);
+            prefetchBatch(keys + base, n, hashes);
+            for (size_t i = 0; i < n; ++i) {
+                size_t index;
+                const Layout* slots = find(keys[base + i], hashes[i], index);
+                found[base + i] = slots != nullptr;
+                if (slots) {
+                    values[base + i] = slots->value(index);
+                    ++hits;
+                }
+            }
+        }
+        return hits;
     }
 
     /*
         * Get number of elements in hash table
         * @return number of elements
     */
-    size_t size() override {
+    size_t size() {
         return numElements;
     }
 
@@ -166,61 +770,275 @@ class OpenAddressing : public HashTable<K, V> {
         * Check if hash table is empty
         * @return true if hash table is empty, false otherwise
     */
-    bool empty() override {
+    bool empty() {
         return numElements == 0;
     }
 
     /*
-        * Print all keys in hash table
+        * Write the table to a snapshot image that OpenAddressingSnapshot can
+        * search in place. A pending incremental rehash is finished first.
+        * @param path file to write
+        * @throws std::runtime_error if the file cannot be written
     */
-    void keys() override {
-        for (size_t i = 0; i < tableSize; ++i) {
-            if (table[i].first != EMPTY_KEY
-                && table[i].first != DELETED_KEY) {
-                std::cout << table[i].first << std::endl;
+    void save(const std::string& path) {
+        if (oldTable.capacity() != 0)
+            migrate(oldTable.capacity());
+        uint32_t loadFactorBits;
+        std::memcpy(&loadFactorBits, &maxLoadFactor, sizeof(loadFactorBits));
+        SnapshotHeader header = {};
+        header.kind = SnapshotKind::OpenAddressing;
+        header.hashCheck = hasher(snapshotHashCheckKey<K>());
+        header.arrayCount = 1;
+        header.slotCount = table.capacity();
+        header.elementCount = numElements;
+        header.params[0] = static_cast<uint64_t>(probe.type());
+        header.params[1] = loadFactorBits;
+        header.params[2] = incrementalRehash;
+        const Layout& slots = table;
+        writeSnapshot<K, V>(path, header,
+         [&](size_t i) { return slots.key(i); },
+         [&](size_t i) -> decltype(auto) { return slots.value(i); },
+         [&](size_t i) { return slots.state(i); });
+    }
+
+    /*
+        * Replace the contents of the table with a snapshot image
+        * @param path image written by save()
+        * @throws std::runtime_error if the file is not an image of this
+        * table type or was saved with another probe sequence
+    */
+    void load(const std::string& path) {
+        SnapshotImage<K, V> image(path, SnapshotKind::OpenAddressing,
+         hasher(snapshotHashCheckKey<K>()), MappedAccess::Sequential);
+        const SnapshotHeader& header = image.header();
+        int probingType = static_cast<int>(header.params[0]);
+        Probe loaded(probingType);
+        if (loaded.type() != probingType)
+            throw std::runtime_error("Snapshot of another probe sequence: "
+             + path);
+        size_t slotCount = header.slotCount;
+        Layout slots(slotCount);
+        size_t tombstones = 0;
+        for (size_t i = 0; i < slotCount; ++i) {
+            if (image.states()[i] == SlotState::Full) {
+                slots.set(i, image.keys()[i], image.value(i));
+            } else if (image.states()[i] == SlotState::Deleted) {
+                slots.clear(i, SlotState::Deleted);
+                ++tombstones;
+            }
+        }
+        probe = loaded;
+        table.swap(slots);
+        oldTable = Layout();
+        migrateIndex = 0;
+        numElements = header.elementCount;
+        numTombstones = tombstones;
+        uint32_t loadFactorBits = static_cast<uint32_t>(header.params[1]);
+        std::memcpy(&maxLoadFactor, &loadFactorBits, sizeof(maxLoadFactor));
+        incrementalRehash = header.params[2] != 0;
+        delete[] distances;
+        distances = allocateDistances(slotCount);
+        if (distances) {
+            for (size_t i = 0; i < slotCount; ++i) {
+                if (table.occupied(i)) {
+                    size_t home = hasher(table.key(i)) & (slotCount - 1);
+                    distances[i] = static_cast<uint32_t>(
+                     (i - home) & (slotCount - 1));
+                }
             }
         }
     }
 
     /*
-        * Print all values in hash table
+        * Get number of tombstones left by removals
+        * @return number of deleted slots awaiting cleanup
     */
-    void values() override {
-        for (size_t i = 0; i < tableSize; ++i) {
-            if (table[i].first != EMPTY_KEY
-                && table[i].first != DELETED_KEY) {
-                std::cout << table[i].second << std::endl;
+    size_t getTombstoneCount() const {
+        return numTombstones;
+    }
+
+    /*
+        * Count the probes a successful search of every key in the current
+        * table takes
+        * @return histogram, element i counts keys found after i + 1 probes
+    */
+    std::vector<size_t> getProbeLengthHistogram() const {
+        std::vector<size_t> histogram;
+        size_t mask = table.capacity() - 1;
+        for (size_t i = 0; i < table.capacity(); ++i) {
+            if (!table.occupied(i)) continue;
+            uint64_t h = hasher(table.key(i));
+            size_t probes = 0;
+            while (hash(h, probes, mask) != i) {
+                ++probes;
             }
+            if (histogram.size() <= probes)
+                histogram.resize(probes + 1, 0);
+            ++histogram[probes];
         }
+        return histogram;
+    }
+
+    /*
+        * Gather statistics of the table. Probe lengths and tombstones
+        * cover the current table; a table still draining by incremental
+        * rehash only adds to bytesUsed.
+        * @return statistics
+    */
+    TableStats stats() const {
+        TableStats stats;
+        stats.elements = numElements;
+        stats.capacity = table.capacity();
+        stats.loadFactor = calculateLoadFactor();
+        stats.tombstones = numTombstones;
+        stats.bytesUsed = table.bytes() + oldTable.bytes()
+         + (distances ? table.capacity() * sizeof(uint32_t) : 0);
+        stats.probeLengths = getProbeLengthHistogram();
+        return stats;
+    }
+
+    /*
+        * Check if an incremental rehash is still in progress
+        * @return true if elements are still being migrated
+    */
+    bool isRehashing() const {
+        return oldTable.capacity() != 0;
+    }
+
+    /*
+        * Print all keys in hash table
+    */
+    void keys() {
+        printSlots(table, 0, true, false);
+        printSlots(oldTable, migrateIndex, true, false);
+    }
+
+    /*
+        * Print all values in hash table
+    */
+    void values() {
+        printSlots(table, 0, false, true);
+        printSlots(oldTable, migrateIndex, false, true);
     }
 
     /*
         * Get load factor of hash table
         * @return load factor
     */
-    float getLoadFactor() override {
+    float getLoadFactor() {
         return calculateLoadFactor();
     }
 
     /*
         * Print all key-value pairs in hash table
     */
-    void print() override {
-        for (size_t i = 0; i < tableSize; ++i) {
-            if (table[i].first != EMPTY_KEY
-             && table[i].first != DELETED_KEY) {
-                std::cout << "Key: " << table[i].first <<
-                 ", Value: " << table[i].second << std::endl;
+    void print() {
+        const Layout& slots = table;
+        for (size_t i = 0; i < slots.capacity(); ++i) {
+            if (slots.occupied(i)) {
+                std::cout << "Key: ";
+                printKey(std::cout, slots.key(i));
+                std::cout << ", Value: " << slots.value(i) << std::endl;
             } else {
-                std::cout << "Key: " << table[i].first << std::endl;
+                std::cout << (slots.state(i) == SlotState::Deleted
+                 ? "Deleted" : "Empty") << std::endl;
             }
         }
+        if (isRehashing()) {
+            std::cout << "Rehashing, not yet migrated:" << std::endl;
+            printSlots(oldTable, migrateIndex, true, true);
+        }
     }
 
     /*
         * Destructor
     */
-    ~OpenAddressing() override {
-        delete[] table;
+    ~OpenAddressingTable() {
+        delete[] distances;
     }
 };
+
+/*
+    * Read-only open addressing table searched directly in a mapped
+    * snapshot image, without building a table. Values are returned as
+    * SnapshotValue<V>::View, a string_view for std::string values.
+*/
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class OpenAddressingSnapshot {
+ private:
+    using Codec = SnapshotValue<V>;
+
+    Hash hasher;
+    SnapshotImage<K, V> image;
+    RuntimeProbe probe;
+    size_t mask;
+
+    /*
+        * Find slot holding key, probing as the saved table did
+        * @param key key to search for
+        * @return slot index or mask + 1 if key not found
+    */
+    size_t find(const K& key) const {
+        const SlotState* states = image.states();
+        const K* keys = image.keys();
+        uint64_t h = hasher(key);
+        for (size_t i = 0; i <= mask; ++i) {
+            size_t index = probe(h, i, mask);
+            if (states[index] == SlotState::Full && keys[index] == key)
+                return index;
+            if (states[index] == SlotState::Empty)
+                break;
+        }
+        return mask + 1;
+    }
+
+ public:
+    /*
+        * Constructor, maps an image
+        * @param path image written by OpenAddressingTable::save()
+        * @throws std::runtime_error if the file is not such an image
+    */
+    explicit OpenAddressingSnapshot(const std::string& path)
+        : image(path, SnapshotKind::OpenAddressing,
+           Hash()(snapshotHashCheckKey<K>()), MappedAccess::Random),
+          probe(static_cast<int>(image.header().params[0])),
+          mask(image.header().slotCount - 1) {}
+
+    /*
+        * Search for key
+        * @param key key to search for
+        * @return view of the value associated with key
+        * @throws std::range_error if key not found
+    */
+    typename Codec::View search(const K& key) const {
+        size_t index = find(key);
+        if (index > mask)
+            throw std::range_error("Key not found");
+        return Codec::view(image.values()[index], image.heap());
+    }
+
+    /*
+        * Check if key exists
+        * @param key key to check
+        * @return true if key exists, false otherwise
+    */
+    bool exists(const K& key) const {
+        return find(key) <= mask;
+    }
+
+    /*
+        * Get number of elements
+        * @return number of elements
+    */
+    size_t size() const {
+        return image.header().elementCount;
+    }
+};
+
+/*
+    * Open addressing behind the virtual HashTable interface
+*/
+template <typename K, typename V, typename Layout = PairLayout<K, V>,
+ typename Hash = WyMixHash<K>, typename Probe = RuntimeProbe>
+using OpenAddressing =
+ HashTableAdapter<OpenAddressingTable<K, V, Layout, Hash, Probe>, K, V>;
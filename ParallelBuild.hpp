@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "./HashFunctions.hpp"
+
+/*
+    * Helpers for the bulkLoad implementations: a radix pass that groups
+    * input entries by the part of the table they land in, and a loop that
+    * hands parts out to worker threads, so every part is filled by one
+    * thread without locks.
+*/
+
+// Inputs below this size are loaded on the calling thread alone
+constexpr size_t PARALLEL_BUILD_THRESHOLD = 1 << 14;
+
+/*
+    * Number of threads worth using for a bulk load
+    * @param count number of entries to load
+    * @return 1 for small inputs, the number of hardware threads otherwise
+*/
+inline unsigned buildThreadCount(size_t count) {
+    if (count < PARALLEL_BUILD_THRESHOLD)
+        return 1;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*
+    * Number of parts to split a table into for a bulk load. A few parts
+    * per thread even out uneven parts.
+    * @param threads number of threads filling the table
+    * @param limit largest useful number of parts, a power of two
+    * @return power of two not above limit
+*/
+inline size_t buildPartCount(unsigned threads, size_t limit) {
+    size_t parts = threads > 1 ? roundUpToPowerOfTwo(threads * 8) : 1;
+    return std::min(parts, limit);
+}
+
+/*
+    * Run work(part) for every part in [0, parts). Each thread takes the
+    * next part when it finishes one; the calling thread works as well.
+    * The first exception thrown by work stops the remaining parts and is
+    * rethrown on the calling thread.
+    * @param parts number of parts
+    * @param threads number of threads to use
+    * @param work function called with each part index
+*/
+template <typename Work>
+void parallelFor(size_t parts, unsigned threads, Work work) {
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorLock;
+    auto run = [&]() {
+        for (size_t part = next++; part < parts; part = next++) {
+            try {
+                work(part);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error)
+                    error = std::current_exception();
+                next = parts;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads && t < parts; ++t) {
+        workers.emplace_back(run);
+    }
+    run();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/*
+    * Group entry indices by part in one parallel radix pass. Entries of a
+    * part keep their input order, so a later duplicate still wins. A
+    * single part needs no pass and keeps the input order.
+    * @param count number of entries
+    * @param parts number of parts
+    * @param threads number of threads to use
+    * @param partOf maps an entry index to its part
+    * @param order set to the entry indices, grouped by part
+    * @return offsets, part p owns order[offsets[p], offsets[p + 1])
+*/
+template <typename PartOf>
+std::vector<size_t> partitionEntries(size_t count, size_t parts,
+ unsigned threads, PartOf partOf, std::vector<size_t>& order) {
+    if (parts == 1) {
+        order.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        return {0, count};
+    }
+    size_t chunks = threads;
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<uint32_t> partIds(count);
+    std::vector<size_t> histogram(chunks * parts, 0);
+    parallelFor(chunks, threads, [&](size_t chunk) {
+        size_t* counts = &histogram[chunk * parts];
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i) {
+            partIds[i] = static_cast<uint32_t>(partOf(i));
+            ++counts[partIds[i]];
+        }
+    });
+    // Turn counts into the position where each chunk writes each part
+    std::vector<size_t> offsets(parts + 1, 0);
+    size_t position = 0;
+    for (size_t part = 0; part < parts; ++part) {
+        offsets[part] = position;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            size_t n = histogram[chunk * parts + part];
+            histogram[chunk * parts + part] = position;
+            position += n;
+        }
+    }
+    offsets[parts] = position;
+    order.resize(count);
+    parallelFor(chunks, threads, [&](size_t chunk) {
+        size_t* positions = &histogram[chunk * parts];
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i) {
+            order[positions[partIds[i]]++] = i;
+        }
+    });
+    return offsets;
+}
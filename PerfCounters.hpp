@@ -0,0 +1,206 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#ifdef PERF_COUNTERS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+/*
+    * Hardware performance counters around benchmark runs, read through
+    * Linux perf_event_open. Counting is compiled in with -DPERF_COUNTERS
+    * only; without it PerfCounters does nothing and the result files
+    * keep their old columns.
+*/
+
+#ifdef PERF_COUNTERS
+constexpr bool PERF_COUNTERS_ENABLED = true;
+#else
+constexpr bool PERF_COUNTERS_ENABLED = false;
+#endif
+
+constexpr size_t PERF_EVENT_COUNT = 6;
+
+constexpr const char* PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {"cycles",
+ "instructions", "l1dMisses", "llcMisses", "branchMisses", "dtlbMisses"};
+
+/*
+    * Event counts, in the order of PERF_EVENT_NAMES. NaN for a counter
+    * the kernel refused to open or never scheduled.
+*/
+struct PerfSample {
+    double counts[PERF_EVENT_COUNT] = {};
+};
+
+#ifdef PERF_COUNTERS
+/*
+    * One counter per event for the calling thread, user space only. The
+    * counters are not grouped, so the kernel may multiplex them when
+    * there are fewer hardware counters than events; counts are scaled by
+    * the share of time each counter ran.
+*/
+class PerfCounters {
+ private:
+    int fds[PERF_EVENT_COUNT];
+
+    static int openEvent(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+         | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(
+         syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    static uint64_t cacheMiss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+ public:
+    /*
+        * Constructor, opens the counters stopped and at zero. Counters the
+        * kernel refuses, for lack of hardware support or permissions, are
+        * left out.
+    */
+    PerfCounters() {
+        fds[0] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[1] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[2] = openEvent(PERF_TYPE_HW_CACHE,
+         cacheMiss(PERF_COUNT_HW_CACHE_L1D));
+        fds[3] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[4] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds[5] = openEvent(PERF_TYPE_HW_CACHE,
+         cacheMiss(PERF_COUNT_HW_CACHE_DTLB));
+        for (int fd : fds) {
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+        for (int fd : fds) {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    // Whether at least one counter could be opened
+    bool available() const {
+        for (int fd : fds) {
+            if (fd >= 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Start counting; counts add up over every start/stop pair
+    void start() {
+        for (int fd : fds) {
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        for (int fd : fds) {
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    /*
+        * Counts since construction
+        * @return scaled counts
+    */
+    PerfSample sample() const {
+        PerfSample sample;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            uint64_t data[3];  // value, time enabled, time running
+            if (fds[i] < 0
+             || read(fds[i], data, sizeof(data)) != sizeof(data)
+             || (data[1] != 0 && data[2] == 0)) {
+                sample.counts[i] = std::numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+            sample.counts[i] = data[2] == 0 ? 0
+             : static_cast<double>(data[0]) * data[1] / data[2];
+        }
+        return sample;
+    }
+};
+#else
+// Stand-in without any counters, every call compiles to nothing
+class PerfCounters {
+ public:
+    bool available() const { return false; }
+    void start() {}
+    void stop() {}
+    PerfSample sample() const {
+        PerfSample sample;
+        for (double& count : sample.counts) {
+            count = std::numeric_limits<double>::quiet_NaN();
+        }
+        return sample;
+    }
+};
+#endif
+
+/*
+    * Add the counts of another sample
+    * @param total sample added to
+    * @param sample sample to add
+*/
+inline void addPerfSample(PerfSample& total, const PerfSample& sample) {
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        total.counts[i] += sample.counts[i];
+    }
+}
+
+/*
+    * Extra CSV header columns for the counters, empty when counting is
+    * not compiled in
+    * @return ";"-separated names, each preceded by ";"
+*/
+inline std::string perfCsvHeader() {
+    std::string header;
+    if (PERF_COUNTERS_ENABLED) {
+        for (const char* name : PERF_EVENT_NAMES) {
+            header += std::string(";") + name;
+        }
+    }
+    return header;
+}
+
+/*
+    * Extra CSV columns with counts per operation, empty when counting is
+    * not compiled in
+    * @param sample counts of all operations
+    * @param operations number of operations counted
+    * @return ";"-separated counts, each preceded by ";"
+*/
+inline std::string perfCsvColumns(const PerfSample& sample,
+ double operations) {
+    std::ostringstream columns;
+    if (PERF_COUNTERS_ENABLED) {
+        for (double count : sample.counts) {
+            columns << ";" << count / operations;
+        }
+    }
+    return columns.str();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "./HashFunctions.hpp"
+
+/*
+    * Probe sequence policies for OpenAddressing over power-of-two tables.
+    * A policy maps the hash of a key and the iteration number to a slot.
+    * The compile-time policies let every probing variant compile to its
+    * own loop, RuntimeProbe picks the sequence from a probing type number.
+    * Every policy is constructible from that number so tables can take
+    * either kind; the compile-time ones ignore it.
+*/
+
+/*
+    * Linear probing, probing type 0
+*/
+struct LinearProbe {
+    explicit LinearProbe(int = 0) {}
+    size_t operator()(uint64_t h, size_t i, size_t mask) const {
+        return (h + i) & mask;
+    }
+    constexpr bool isLinear() const { return true; }
+    constexpr bool isRobinHood() const { return false; }
+    constexpr int type() const { return 0; }
+};
+
+/*
+    * Quadratic probing, probing type 1. Triangular steps visit every slot.
+*/
+struct QuadraticProbe {
+    explicit QuadraticProbe(int = 1) {}
+    size_t operator()(uint64_t h, size_t i, size_t mask) const {
+        return (h + i * (i + 1) / 2) & mask;
+    }
+    constexpr bool isLinear() const { return false; }
+    constexpr bool isRobinHood() const { return false; }
+    constexpr int type() const { return 1; }
+};
+
+/*
+    * Double hashing, probing type 2. The step is a second hash remixed
+    * from the first, so it differs between keys even when the hash policy
+    * leaves the high bits zero, as IdentityHash does for int keys. It is
+    * odd, so it visits every slot.
+*/
+struct DoubleHashProbe {
+    explicit DoubleHashProbe(int = 2) {}
+    size_t operator()(uint64_t h, size_t i, size_t mask) const {
+        return (h + i * (remixHash(h) | 1)) & mask;
+    }
+    constexpr bool isLinear() const { return false; }
+    constexpr bool isRobinHood() const { return false; }
+    constexpr int type() const { return 2; }
+};
+
+/*
+    * Robin Hood hashing, probing type 3: a linear probe sequence whose
+    * entries are kept ordered by their distance from home
+*/
+struct RobinHoodProbe {
+    explicit RobinHoodProbe(int = 3) {}
+    size_t operator()(uint64_t h, size_t i, size_t mask) const {
+        return (h + i) & mask;
+    }
+    constexpr bool isLinear() const { return true; }
+    constexpr bool isRobinHood() const { return true; }
+    constexpr int type() const { return 3; }
+};
+
+/*
+    * Probe sequence chosen at run time: 0 for linear probing, 1 for
+    * quadratic probing, 2 for double hashing, 3 for Robin Hood hashing.
+    * Unknown types fall back to linear probing.
+*/
+class RuntimeProbe {
+ private:
+    int probingType;
+
+ public:
+    explicit RuntimeProbe(int probingType) : probingType(probingType) {}
+
+    size_t operator()(uint64_t h, size_t i, size_t mask) const {
+        switch (probingType) {
+            case 1:
+                return QuadraticProbe()(h, i, mask);
+            case 2:
+                return DoubleHashProbe()(h, i, mask);
+            default:
+                return LinearProbe()(h, i, mask);
+        }
+    }
+    bool isLinear() const { return probingType != 1 && probingType != 2; }
+    bool isRobinHood() const { return probingType == 3; }
+    int type() const { return probingType; }
+};
@@ -0,0 +1,859 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+    * Slot storage policies for the open addressing and cuckoo tables.
+    * A layout owns `capacity()` slots, each a key, a value and a SlotState,
+    * and is addressed by slot index only, so tables never see how slots
+    * are laid out in memory. States live in a byte array of their own: no
+    * key value is reserved as a marker, and a probe reads the key of a
+    * slot only once its state says it is full. set() marks a slot full,
+    * moveSlot() carries the state along and leaves the source slot's state
+    * to the caller. CONCURRENT_SET tells whether set() and moveSlot() may
+    * run on disjoint slots from several threads at once. bytes() is the
+    * memory the slots take, without heap memory owned by keys and values.
+*/
+
+// State of a slot
+enum class SlotState : uint8_t {
+    Empty,
+    Full,
+    Deleted,  // tombstone, still part of probe sequences
+};
+
+/*
+    * Array of std::pair slots: a probe that reads a key also pulls the
+    * neighbouring value into cache
+*/
+template <typename K, typename V>
+class PairLayout {
+ private:
+    std::pair<K, V>* slots;
+    SlotState* states;
+    size_t slotCount;
+
+ public:
+    static constexpr bool CONCURRENT_SET = true;
+
+    /*
+        * Constructor of an empty layout without slots
+    */
+    PairLayout() : slots(nullptr), states(nullptr), slotCount(0) {}
+
+    /*
+        * Constructor
+        * @param count number of slots, all empty
+    */
+    explicit PairLayout(size_t count)
+        : slots(new std::pair<K, V>[count]),
+          states(new SlotState[count]), slotCount(count) {
+        std::fill(states, states + slotCount, SlotState::Empty);
+    }
+
+    /*
+        * Copy constructor
+        * @param other layout to copy
+    */
+    PairLayout(const PairLayout& other)
+        : slots(new std::pair<K, V>[other.slotCount]),
+          states(new SlotState[other.slotCount]),
+          slotCount(other.slotCount) {
+        for (size_t i = 0; i < slotCount; ++i) {
+            slots[i] = other.slots[i];
+        }
+        std::copy(other.states, other.states + slotCount, states);
+    }
+
+    /*
+        * Move constructor
+        * @param other layout to take the slots of
+    */
+    PairLayout(PairLayout&& other) noexcept
+        : slots(other.slots), states(other.states),
+          slotCount(other.slotCount) {
+        other.slots = nullptr;
+        other.states = nullptr;
+        other.slotCount = 0;
+    }
+
+    /*
+        * Assignment, copying or moving depending on the argument
+        * @param other layout to assign
+        * @return this layout
+    */
+    PairLayout& operator=(PairLayout other) {
+        swap(other);
+        return *this;
+    }
+
+    /*
+        * Exchange slots with another layout
+        * @param other layout to swap with
+    */
+    void swap(PairLayout& other) {
+        std::swap(slots, other.slots);
+        std::swap(states, other.states);
+        std::swap(slotCount, other.slotCount);
+    }
+
+    size_t capacity() const { return slotCount; }
+    size_t bytes() const {
+        return slotCount * (sizeof(std::pair<K, V>) + sizeof(SlotState));
+    }
+    SlotState state(size_t i) const { return states[i]; }
+    bool occupied(size_t i) const { return states[i] == SlotState::Full; }
+    K& key(size_t i) { return slots[i].first; }
+    const K& key(size_t i) const { return slots[i].first; }
+    V& value(size_t i) { return slots[i].second; }
+    const V& value(size_t i) const { return slots[i].second; }
+
+    // Pull the state and the key of a slot into cache
+    void prefetch(size_t i) const {
+        __builtin_prefetch(&states[i]);
+        __builtin_prefetch(&slots[i]);
+    }
+
+    /*
+        * Store key-value pair in slot
+        * @param i slot index
+        * @param k key to store
+        * @param v value to store
+    */
+    void set(size_t i, const K& k, const V& v) {
+        slots[i].first = k;
+        slots[i].second = v;
+        states[i] = SlotState::Full;
+    }
+
+    /*
+        * Release the key and value of a slot
+        * @param i slot index
+        * @param mark SlotState::Empty or SlotState::Deleted
+    */
+    void clear(size_t i, SlotState mark) {
+        slots[i].first = K();
+        slots[i].second = V();
+        states[i] = mark;
+    }
+
+    /*
+        * Move contents of one slot into another
+        * @param to destination slot
+        * @param from source slot
+    */
+    void moveSlot(size_t to, size_t from) {
+        slots[to] = std::move(slots[from]);
+        states[to] = states[from];
+    }
+
+    /*
+        * Exchange the value of a slot with another value
+        * @param i slot index
+        * @param v value to store, set to the previous value of the slot
+    */
+    void swapValue(size_t i, V& v) {
+        std::swap(slots[i].second, v);
+    }
+
+    /*
+        * Destructor
+    */
+    ~PairLayout() {
+        delete[] slots;
+        delete[] states;
+    }
+};
+
+/*
+    * Structure of arrays: keys are packed densely so probe loops scan only
+    * keys, and a value is touched once the matching key is found
+*/
+template <typename K, typename V>
+class SplitLayout {
+ private:
+    K* keyArray;
+    V* valueArray;
+    SlotState* states;
+    size_t slotCount;
+
+ public:
+    static constexpr bool CONCURRENT_SET = true;
+
+    /*
+        * Constructor of an empty layout without slots
+    */
+    SplitLayout()
+        : keyArray(nullptr), valueArray(nullptr), states(nullptr),
+          slotCount(0) {}
+
+    /*
+        * Constructor
+        * @param count number of slots, all empty
+    */
+    explicit SplitLayout(size_t count)
+        : keyArray(new K[count]), valueArray(new V[count]),
+          states(new SlotState[count]), slotCount(count) {
+        std::fill(states, states + slotCount, SlotState::Empty);
+    }
+
+    /*
+        * Copy constructor
+        * @param other layout to copy
+    */
+    SplitLayout(const SplitLayout& other)
+        : keyArray(new K[other.slotCount]), valueArray(new V[other.slotCount]),
+          states(new SlotState[other.slotCount]),
+          slotCount(other.slotCount) {
+        for (size_t i = 0; i < slotCount; ++i) {
+            keyArray[i] = other.keyArray[i];
+            valueArray[i] = other.valueArray[i];
+        }
+        std::copy(other.states, other.states + slotCount, states);
+    }
+
+    /*
+        * Move constructor
+        * @param other layout to take the slots of
+    */
+    SplitLayout(SplitLayout&& other) noexcept
+        : keyArray(other.keyArray), valueArray(other.valueArray),
+          states(other.states), slotCount(other.slotCount) {
+        other.keyArray = nullptr;
+        other.valueArray = nullptr;
+        other.states = nullptr;
+        other.slotCount = 0;
+    }
+
+    /*
+        * Assignment, copying or moving depending on the argument
+        * @param other layout to assign
+        * @return this layout
+    */
+    SplitLayout& operator=(SplitLayout other) {
+        swap(other);
+        return *this;
+    }
+
+    /*
+        * Exchange slots with another layout
+        * @param other layout to swap with
+    */
+    void swap(SplitLayout& other) {
+        std::swap(keyArray, other.keyArray);
+        std::swap(valueArray, other.valueArray);
+        std::swap(states, other.states);
+        std::swap(slotCount, other.slotCount);
+    }
+
+    size_t capacity() const { return slotCount; }
+    size_t bytes() const {
+        return slotCount * (sizeof(K) + sizeof(V) + sizeof(SlotState));
+    }
+    SlotState state(size_t i) const { return states[i]; }
+    bool occupied(size_t i) const { return states[i] == SlotState::Full; }
+    K& key(size_t i) { return keyArray[i]; }
+    const K& key(size_t i) const { return keyArray[i]; }
+    V& value(size_t i) { return valueArray[i]; }
+    const V& value(size_t i) const { return valueArray[i]; }
+
+    // Pull the state and the key of a slot into cache
+    void prefetch(size_t i) const {
+        __builtin_prefetch(&states[i]);
+        __builtin_prefetch(&keyArray[i]);
+    }
+
+    /*
+        * Store key-value pair in slot
+        * @param i slot index
+        * @param k key to store
+        * @param v value to store
+    */
+    void set(size_t i, const K& k, const V& v) {
+        keyArray[i] = k;
+        valueArray[i] = v;
+        states[i] = SlotState::Full;
+    }
+
+    /*
+        * Release the key and value of a slot
+        * @param i slot index
+        * @param mark SlotState::Empty or SlotState::Deleted
+    */
+    void clear(size_t i, SlotState mark) {
+        keyArray[i] = K();
+        valueArray[i] = V();
+        states[i] = mark;
+    }
+
+    /*
+        * Move contents of one slot into another
+        * @param to destination slot
+        * @param from source slot
+    */
+    void moveSlot(size_t to, size_t from) {
+        keyArray[to] = std::move(keyArray[from]);
+        valueArray[to] = std::move(valueArray[from]);
+        states[to] = states[from];
+    }
+
+    /*
+        * Exchange the value of a slot with another value
+        * @param i slot index
+        * @param v value to store, set to the previous value of the slot
+    */
+    void swapValue(size_t i, V& v) {
+        std::swap(valueArray[i], v);
+    }
+
+    /*
+        * Destructor
+    */
+    ~SplitLayout() {
+        delete[] keyArray;
+        delete[] valueArray;
+        delete[] states;
+    }
+};
+
+/*
+    * Slots for std::string values that keep no std::string at all. A slot
+    * holds its key and a 16-byte ArenaString: values of up to 12 bytes are
+    * stored inline, longer ones as an offset into an append-only arena
+    * owned by the layout. Copying the layout copies two flat arrays.
+*/
+template <typename K>
+class ArenaLayout {
+ private:
+    static constexpr uint32_t INLINE_CAPACITY = 12;
+
+    struct ArenaString {
+        uint32_t length;
+        char bytes[INLINE_CAPACITY];  // the value, or its arena offset
+    };
+
+    struct Slot {
+        K key;
+        ArenaString value;
+    };
+
+    Slot* slots;
+    SlotState* states;
+    size_t slotCount;
+    std::vector<char> arena;
+    size_t garbage;  // arena bytes no slot refers to anymore
+
+    static uint64_t offsetOf(const ArenaString& value) {
+        uint64_t offset;
+        std::memcpy(&offset, value.bytes, sizeof(offset));
+        return offset;
+    }
+
+    /*
+        * Bytes of a stored value
+        * @param value stored value
+        * @return view into the slot or into the arena
+    */
+    std::string_view view(const ArenaString& value) const {
+        if (value.length <= INLINE_CAPACITY)
+            return std::string_view(value.bytes, value.length);
+        return std::string_view(arena.data() + offsetOf(value), value.length);
+    }
+
+    /*
+        * Store a value in a slot, releasing the value it held
+        * @param i slot index
+        * @param v value to store
+        * @throws std::length_error if v is longer than 4 GiB
+    */
+    void store(size_t i, std::string_view v) {
+        if (v.size() > UINT32_MAX)
+            throw std::length_error("ArenaLayout value too long");
+        ArenaString& value = slots[i].value;
+        if (value.length > INLINE_CAPACITY)
+            garbage += value.length;
+        value.length = 0;
+        if (v.size() <= INLINE_CAPACITY) {
+            std::memcpy(value.bytes, v.data(), v.size());
+        } else {
+            // Compact once most of the arena is dead; the slot scan is paid
+            // for by at least slotCount released bytes
+            if (garbage > arena.size() / 2 && garbage > slotCount)
+                compact();
+            uint64_t offset = arena.size();
+            arena.insert(arena.end(), v.begin(), v.end());
+            std::memcpy(value.bytes, &offset, sizeof(offset));
+        }
+        value.length = static_cast<uint32_t>(v.size());
+    }
+
+    /*
+        * Copy the values still referred to into a fresh arena
+    */
+    void compact() {
+        std::vector<char> live;
+        live.reserve(arena.size() - garbage);
+        for (size_t i = 0; i < slotCount; ++i) {
+            ArenaString& value = slots[i].value;
+            if (value.length <= INLINE_CAPACITY)
+                continue;
+            uint64_t offset = live.size();
+            const char* bytes = arena.data() + offsetOf(value);
+            live.insert(live.end(), bytes, bytes + value.length);
+            std::memcpy(value.bytes, &offset, sizeof(offset));
+        }
+        arena.swap(live);
+        garbage = 0;
+    }
+
+ public:
+    static constexpr bool CONCURRENT_SET = false;  // set() appends to arena
+
+    /*
+        * Handle to the value of a slot, reading and assigning it like a
+        * std::string
+    */
+    class Reference {
+     private:
+        ArenaLayout* layout;
+        size_t index;
+
+     public:
+        Reference(ArenaLayout* layout, size_t index)
+            : layout(layout), index(index) {}
+
+        operator std::string() const {
+            return std::string(layout->view(layout->slots[index].value));
+        }
+
+        Reference& operator=(const std::string& v) {
+            layout->store(index, v);
+            return *this;
+        }
+
+        Reference& operator=(const Reference& other) {
+            return *this = std::string(other);
+        }
+
+        friend std::ostream& operator<<(std::ostream& out,
+         const Reference& r) {
+            const ArenaLayout& layout = *r.layout;
+            return out << layout.value(r.index);
+        }
+    };
+
+    /*
+        * Constructor of an empty layout without slots
+    */
+    ArenaLayout()
+        : slots(nullptr), states(nullptr), slotCount(0), garbage(0) {}
+
+    /*
+        * Constructor
+        * @param count number of slots, all empty
+    */
+    explicit ArenaLayout(size_t count)
+        : slots(new Slot[count]), states(new SlotState[count]),
+          slotCount(count), garbage(0) {
+        for (size_t i = 0; i < slotCount; ++i) {
+            slots[i].value.length = 0;
+        }
+        std::fill(states, states + slotCount, SlotState::Empty);
+    }
+
+    /*
+        * Copy constructor, copying the slots and the arena as they are
+        * @param other layout to copy
+    */
+    ArenaLayout(const ArenaLayout& other)
+        : slots(new Slot[other.slotCount]),
+          states(new SlotState[other.slotCount]), slotCount(other.slotCount),
+          arena(other.arena), garbage(other.garbage) {
+        std::copy(other.slots, other.slots + slotCount, slots);
+        std::copy(other.states, other.states + slotCount, states);
+    }
+
+    /*
+        * Move constructor
+        * @param other layout to take the slots of
+    */
+    ArenaLayout(ArenaLayout&& other) noexcept
+        : slots(other.slots), states(other.states),
+          slotCount(other.slotCount), arena(std::move(other.arena)),
+          garbage(other.garbage) {
+        other.slots = nullptr;
+        other.states = nullptr;
+        other.slotCount = 0;
+        other.garbage = 0;
+    }
+
+    /*
+        * Assignment, copying or moving depending on the argument
+        * @param other layout to assign
+        * @return this layout
+    */
+    ArenaLayout& operator=(ArenaLayout other) {
+        swap(other);
+        return *this;
+    }
+
+    /*
+        * Exchange slots with another layout
+        * @param other layout to swap with
+    */
+    void swap(ArenaLayout& other) {
+        std::swap(slots, other.slots);
+        std::swap(states, other.states);
+        std::swap(slotCount, other.slotCount);
+        arena.swap(other.arena);
+        std::swap(garbage, other.garbage);
+    }
+
+    size_t capacity() const { return slotCount; }
+    size_t bytes() const {
+        return slotCount * (sizeof(Slot) + sizeof(SlotState))
+         + arena.capacity();
+    }
+    SlotState state(size_t i) const { return states[i]; }
+    bool occupied(size_t i) const { return states[i] == SlotState::Full; }
+    K& key(size_t i) { return slots[i].key; }
+    const K& key(size_t i) const { return slots[i].key; }
+    Reference value(size_t i) { return Reference(this, i); }
+    std::string value(size_t i) const {
+        return std::string(view(slots[i].value));
+    }
+
+    // Pull the state and the key of a slot into cache
+    void prefetch(size_t i) const {
+        __builtin_prefetch(&states[i]);
+        __builtin_prefetch(&slots[i]);
+    }
+
+    /*
+        * Store key-value pair in slot
+        * @param i slot index
+        * @param k key to store
+        * @param v value to store
+    */
+    void set(size_t i, const K& k, const std::string& v) {
+        slots[i].key = k;
+        store(i, v);
+        states[i] = SlotState::Full;
+    }
+
+    /*
+        * Release the key and value of a slot
+        * @param i slot index
+        * @param mark SlotState::Empty or SlotState::Deleted
+    */
+    void clear(size_t i, SlotState mark) {
+        slots[i].key = K();
+        if (slots[i].value.length > INLINE_CAPACITY)
+            garbage += slots[i].value.length;
+        slots[i].value.length = 0;
+        states[i] = mark;
+    }
+
+    /*
+        * Move contents of one slot into another, leaving the source slot
+        * with an empty value
+        * @param to destination slot
+        * @param from source slot
+    */
+    void moveSlot(size_t to, size_t from) {
+        if (slots[to].value.length > INLINE_CAPACITY)
+            garbage += slots[to].value.length;
+        slots[to] = slots[from];
+        slots[from].value.length = 0;
+        states[to] = states[from];
+    }
+
+    /*
+        * Exchange the value of a slot with another value
+        * @param i slot index
+        * @param v value to store, set to the previous value of the slot
+    */
+    void swapValue(size_t i, std::string& v) {
+        std::string previous(view(slots[i].value));
+        store(i, v);
+        v.swap(previous);
+    }
+
+    /*
+        * Destructor
+    */
+    ~ArenaLayout() {
+        delete[] slots;
+        delete[] states;
+    }
+};
+
+/*
+    * Copy-on-write slots for cheap clones. Slots are split into pages of
+    * PAGE_SLOTS pairs and the page directory and every page are reference
+    * counted, so copying a layout only shares its directory. The first
+    * write through a copy duplicates the directory, and a write to a page
+    * still shared with another copy duplicates that page alone. Reads
+    * through a const layout never copy anything, so tables read through
+    * const slots on their lookup paths. Copies may live on other threads:
+    * a shared page is never written, only replaced.
+*/
+template <typename K, typename V, size_t PAGE_SLOTS = 1024>
+class PagedLayout {
+ private:
+    static_assert((PAGE_SLOTS & (PAGE_SLOTS - 1)) == 0,
+     "PAGE_SLOTS must be a power of two");
+
+    struct Page {
+        std::atomic<size_t> refs;
+        std::vector<std::pair<K, V>> slots;
+        std::vector<SlotState> states;
+
+        Page(std::vector<std::pair<K, V>> slots,
+         std::vector<SlotState> states)
+            : refs(1), slots(std::move(slots)), states(std::move(states)) {}
+    };
+
+    struct Directory {
+        std::atomic<size_t> refs;
+        std::vector<Page*> pages;
+
+        explicit Directory(std::vector<Page*> pages)
+            : refs(1), pages(std::move(pages)) {}
+    };
+
+    Directory* directory;
+    size_t slotCount;
+
+    /*
+        * Drop one reference to a page, deleting it with the last one
+        * @param page page to release
+    */
+    static void release(Page* page) {
+        if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete page;
+    }
+
+    /*
+        * Drop one reference to a directory, releasing its pages with the
+        * last one
+        * @param dir directory to release, may be nullptr
+    */
+    static void release(Directory* dir) {
+        if (!dir || dir->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        for (Page* page : dir->pages) {
+            release(page);
+        }
+        delete dir;
+    }
+
+    /*
+        * Check if this layout holds the only reference
+        * @param refs reference count of a directory or page
+        * @return true if nothing else can read through it
+    */
+    static bool unique(const std::atomic<size_t>& refs) {
+        return refs.load(std::memory_order_acquire) == 1;
+    }
+
+    const Page& page(size_t i) const {
+        return *directory->pages[i / PAGE_SLOTS];
+    }
+
+    const std::pair<K, V>& slot(size_t i) const {
+        return page(i).slots[i % PAGE_SLOTS];
+    }
+
+    /*
+        * Page about to be written, copying the directory and the page
+        * first if they are shared
+        * @param i index of a slot of the page
+        * @return page owned by this layout alone
+    */
+    Page& writablePage(size_t i) {
+        if (!unique(directory->refs)) {
+            for (Page* page : directory->pages) {
+                page->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+            Directory* copy = new Directory(directory->pages);
+            release(directory);
+            directory = copy;
+        }
+        Page*& page = directory->pages[i / PAGE_SLOTS];
+        if (!unique(page->refs)) {
+            Page* copy = new Page(page->slots, page->states);
+            release(page);
+            page = copy;
+        }
+        return *page;
+    }
+
+    std::pair<K, V>& writableSlot(size_t i) {
+        return writablePage(i).slots[i % PAGE_SLOTS];
+    }
+
+ public:
+    static constexpr bool CONCURRENT_SET = false;  // set() may copy pages
+
+    /*
+        * Constructor of an empty layout without slots
+    */
+    PagedLayout() : directory(nullptr), slotCount(0) {}
+
+    /*
+        * Constructor
+        * @param count number of slots, a power of two, all empty
+    */
+    explicit PagedLayout(size_t count)
+        : directory(nullptr), slotCount(count) {
+        size_t pageSlots = std::min(count, PAGE_SLOTS);
+        std::vector<Page*> pages;
+        if (count != 0) {
+            // Every page starts out sharing one empty page and is copied
+            // when first written to
+            Page* empty = new Page(std::vector<std::pair<K, V>>(pageSlots),
+             std::vector<SlotState>(pageSlots, SlotState::Empty));
+            pages.assign(count / pageSlots, empty);
+            empty->refs.store(pages.size(), std::memory_order_relaxed);
+        }
+        directory = new Directory(std::move(pages));
+    }
+
+    /*
+        * Copy constructor, sharing the pages of the other layout
+        * @param other layout to copy
+    */
+    PagedLayout(const PagedLayout& other)
+        : directory(other.directory), slotCount(other.slotCount) {
+        if (directory)
+            directory->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+        * Move constructor
+        * @param other layout to take the slots of
+    */
+    PagedLayout(PagedLayout&& other) noexcept
+        : directory(other.directory), slotCount(other.slotCount) {
+        other.directory = nullptr;
+        other.slotCount = 0;
+    }
+
+    /*
+        * Assignment, copying or moving depending on the argument
+        * @param other layout to assign
+        * @return this layout
+    */
+    PagedLayout& operator=(PagedLayout other) {
+        swap(other);
+        return *this;
+    }
+
+    /*
+        * Exchange slots with another layout
+        * @param other layout to swap with
+    */
+    void swap(PagedLayout& other) {
+        std::swap(directory, other.directory);
+        std::swap(slotCount, other.slotCount);
+    }
+
+    size_t capacity() const { return slotCount; }
+
+    /*
+        * Bytes of the directory and its distinct pages, pages shared with
+        * copies included
+        * @return bytes
+    */
+    size_t bytes() const {
+        if (!directory)
+            return 0;
+        std::vector<Page*> pages(directory->pages);
+        std::sort(pages.begin(), pages.end());
+        size_t distinct = std::unique(pages.begin(), pages.end())
+         - pages.begin();
+        return sizeof(Directory) + pages.size() * sizeof(Page*)
+         + distinct * (sizeof(Page) + PAGE_SLOTS
+          * (sizeof(std::pair<K, V>) + sizeof(SlotState)));
+    }
+
+    SlotState state(size_t i) const {
+        return page(i).states[i % PAGE_SLOTS];
+    }
+    bool occupied(size_t i) const { return state(i) == SlotState::Full; }
+    K& key(size_t i) { return writableSlot(i).first; }
+    const K& key(size_t i) const { return slot(i).first; }
+    V& value(size_t i) { return writableSlot(i).second; }
+    const V& value(size_t i) const { return slot(i).second; }
+
+    // Pull the state and the key of a slot into cache
+    void prefetch(size_t i) const {
+        const Page& p = page(i);
+        __builtin_prefetch(&p.states[i % PAGE_SLOTS]);
+        __builtin_prefetch(&p.slots[i % PAGE_SLOTS]);
+    }
+
+    /*
+        * Store key-value pair in slot
+        * @param i slot index
+        * @param k key to store
+        * @param v value to store
+    */
+    void set(size_t i, const K& k, const V& v) {
+        Page& p = writablePage(i);
+        p.slots[i % PAGE_SLOTS].first = k;
+        p.slots[i % PAGE_SLOTS].second = v;
+        p.states[i % PAGE_SLOTS] = SlotState::Full;
+    }
+
+    /*
+        * Release the key and value of a slot
+        * @param i slot index
+        * @param mark SlotState::Empty or SlotState::Deleted
+    */
+    void clear(size_t i, SlotState mark) {
+        Page& p = writablePage(i);
+        p.slots[i % PAGE_SLOTS].first = K();
+        p.slots[i % PAGE_SLOTS].second = V();
+        p.states[i % PAGE_SLOTS] = mark;
+    }
+
+    /*
+        * Move contents of one slot into another
+        * @param to destination slot
+        * @param from source slot
+    */
+    void moveSlot(size_t to, size_t from) {
+        Page& source = writablePage(from);
+        Page& target = writablePage(to);
+        target.slots[to % PAGE_SLOTS] =
+         std::move(source.slots[from % PAGE_SLOTS]);
+        target.states[to % PAGE_SLOTS] = source.states[from % PAGE_SLOTS];
+    }
+
+    /*
+        * Exchange the value of a slot with another value
+        * @param i slot index
+        * @param v value to store, set to the previous value of the slot
+    */
+    void swapValue(size_t i, V& v) {
+        std::swap(writableSlot(i).second, v);
+    }
+
+    /*
+        * Destructor
+    */
+    ~PagedLayout() {
+        release(directory);
+    }
+};
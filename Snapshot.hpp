@@ -0,0 +1,251 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "./MappedFile.hpp"
+#include "./SlotLayout.hpp"
+
+/*
+    * Binary snapshot images of hash tables. An image is a header followed
+    * by the slot arrays exactly as a lookup reads them: the state of every
+    * slot, every key, then every stored value, then a heap with the bytes
+    * of variable-length values. Sections start at multiples of
+    * SNAPSHOT_ALIGNMENT, so a mapped image can be searched in place
+    * without deserializing.
+*/
+
+constexpr char SNAPSHOT_MAGIC[8] = {'H', 'T', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;  // 2: slot states apart from keys
+constexpr size_t SNAPSHOT_ALIGNMENT = 64;
+
+// Table an image was written by
+enum class SnapshotKind : uint32_t {
+    OpenAddressing = 1,
+    Cuckoo = 2,
+    ClosedAddressing = 3,
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    SnapshotKind kind;
+    uint32_t keySize;  // sizeof(K)
+    uint32_t storedValueSize;  // sizeof(SnapshotValue<V>::Stored)
+    uint64_t hashCheck;  // hash of snapshotHashCheckKey()
+    uint64_t arrayCount;  // slot arrays, two for cuckoo hashing
+    uint64_t slotCount;  // slots per array
+    uint64_t elementCount;
+    uint64_t params[6];  // table specific settings
+    uint64_t statesOffset;  // arrayCount * slotCount SlotState bytes
+    uint64_t keysOffset;  // arrayCount * slotCount keys
+    uint64_t valuesOffset;  // arrayCount * slotCount stored values
+    uint64_t heapOffset;
+    uint64_t heapSize;
+};
+
+/*
+    * Key whose hash is recorded in every image, so a table or view with a
+    * different hash policy refuses to read it
+    * @return fixed key
+*/
+template <typename K>
+constexpr K snapshotHashCheckKey() {
+    return static_cast<K>(0x2545F491);
+}
+
+/*
+    * How values are stored in an image. Trivially copyable values are
+    * stored as they are and read back in place.
+*/
+template <typename V>
+struct SnapshotValue {
+    static_assert(std::is_trivially_copyable<V>::value,
+     "snapshots need trivially copyable values or std::string");
+
+    using Stored = V;
+    using View = V;
+
+    static Stored store(const V& value, std::string&) {
+        return value;
+    }
+    static V restore(const Stored& stored, const char*) {
+        return stored;
+    }
+    static View view(const Stored& stored, const char*) {
+        return stored;
+    }
+};
+
+/*
+    * Strings are stored as a reference into the heap of the image, read
+    * in place as string_views
+*/
+template <>
+struct SnapshotValue<std::string> {
+    struct Stored {
+        uint64_t offset;
+        uint64_t length;
+    };
+    using View = std::string_view;
+
+    static Stored store(std::string_view value, std::string& heap) {
+        Stored stored = {heap.size(), value.size()};
+        heap += value;
+        return stored;
+    }
+    static std::string restore(const Stored& stored, const char* heap) {
+        return std::string(heap + stored.offset, stored.length);
+    }
+    static View view(const Stored& stored, const char* heap) {
+        return View(heap + stored.offset, stored.length);
+    }
+};
+
+/*
+    * Round an offset up to the next section boundary
+    * @param offset offset in bytes
+    * @return aligned offset
+*/
+inline uint64_t alignSnapshotOffset(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+}
+
+/*
+    * Write an image. Slots that are not full store a default key and a
+    * zeroed value; their state tells empty and deleted slots apart.
+    * @param path file to write
+    * @param header kind, hashCheck, counts and params of the table; the
+    * remaining fields are filled in here
+    * @param keyAt key of slot i, slots of all arrays numbered in a row
+    * @param valueAt value of slot i
+    * @param stateAt SlotState of slot i
+    * @throws std::runtime_error if the file cannot be written
+*/
+template <typename K, typename V, typename KeyAt, typename ValueAt,
+ typename StateAt>
+void writeSnapshot(const std::string& path, SnapshotHeader header,
+ KeyAt keyAt, ValueAt valueAt, StateAt stateAt) {
+    using Codec = SnapshotValue<V>;
+    static_assert(std::is_trivially_copyable<K>::value,
+     "snapshots need trivially copyable keys");
+    size_t slots = header.arrayCount * header.slotCount;
+    std::vector<SlotState> states(slots);
+    std::vector<K> keys(slots);
+    std::vector<typename Codec::Stored> stored(slots);
+    std::string heap;
+    for (size_t i = 0; i < slots; ++i) {
+        states[i] = stateAt(i);
+        if (states[i] == SlotState::Full) {
+            keys[i] = keyAt(i);
+            stored[i] = Codec::store(valueAt(i), heap);
+        } else {
+            keys[i] = K();
+            std::memset(&stored[i], 0, sizeof(stored[i]));
+        }
+    }
+
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.keySize = sizeof(K);
+    header.storedValueSize = sizeof(typename Codec::Stored);
+    header.statesOffset = alignSnapshotOffset(sizeof(SnapshotHeader));
+    header.keysOffset = alignSnapshotOffset(
+     header.statesOffset + slots * sizeof(SlotState));
+    header.valuesOffset = alignSnapshotOffset(
+     header.keysOffset + slots * sizeof(K));
+    header.heapOffset = alignSnapshotOffset(
+     header.valuesOffset + slots * sizeof(typename Codec::Stored));
+    header.heapSize = heap.size();
+
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+        static const char padding[SNAPSHOT_ALIGNMENT] = {};
+        output.write(padding, offset - static_cast<uint64_t>(output.tellp()));
+        output.write(static_cast<const char*>(data), size);
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.statesOffset, states.data(), slots * sizeof(SlotState));
+    writeAt(header.keysOffset, keys.data(), slots * sizeof(K));
+    writeAt(header.valuesOffset, stored.data(),
+     slots * sizeof(typename Codec::Stored));
+    writeAt(header.heapOffset, heap.data(), heap.size());
+    output.close();
+    if (!output)
+        throw std::runtime_error("Cannot write snapshot " + path);
+}
+
+/*
+    * Mapped image, checked against the table type reading it
+*/
+template <typename K, typename V>
+class SnapshotImage {
+ private:
+    using Stored = typename SnapshotValue<V>::Stored;
+
+    MappedFile file;
+    const SnapshotHeader* header_;
+
+ public:
+    /*
+        * Constructor, maps and checks an image
+        * @param path image to map
+        * @param kind table the image must come from
+        * @param hashCheck hash of snapshotHashCheckKey() under the reader's
+        * hash policy
+        * @param access Sequential for loading the whole image into a
+        * table, Random for a view searching it in place
+        * @throws std::runtime_error if the file is no such image
+    */
+    SnapshotImage(const std::string& path, SnapshotKind kind,
+     uint64_t hashCheck, MappedAccess access) : file(path, access) {
+        header_ = reinterpret_cast<const SnapshotHeader*>(file.begin());
+        if (file.size() < sizeof(SnapshotHeader)
+         || std::memcmp(header_->magic, SNAPSHOT_MAGIC,
+          sizeof(SNAPSHOT_MAGIC)) != 0)
+            throw std::runtime_error("Not a snapshot: " + path);
+        if (header_->version != SNAPSHOT_VERSION)
+            throw std::runtime_error("Unsupported snapshot version: " + path);
+        if (header_->kind != kind || header_->keySize != sizeof(K)
+         || header_->storedValueSize != sizeof(Stored)
+         || header_->hashCheck != hashCheck)
+            throw std::runtime_error("Snapshot of another table type: "
+             + path);
+        uint64_t slots = header_->arrayCount * header_->slotCount;
+        if (header_->statesOffset + slots * sizeof(SlotState) > file.size()
+         || header_->keysOffset + slots * sizeof(K) > file.size()
+         || header_->valuesOffset + slots * sizeof(Stored) > file.size()
+         || header_->heapOffset + header_->heapSize > file.size())
+            throw std::runtime_error("Truncated snapshot: " + path);
+    }
+
+    const SnapshotHeader& header() const { return *header_; }
+
+    const SlotState* states() const {
+        return reinterpret_cast<const SlotState*>(
+         file.begin() + header_->statesOffset);
+    }
+    const K* keys() const {
+        return reinterpret_cast<const K*>(file.begin() + header_->keysOffset);
+    }
+    const Stored* values() const {
+        return reinterpret_cast<const Stored*>(
+         file.begin() + header_->valuesOffset);
+    }
+    const char* heap() const {
+        return file.begin() + header_->heapOffset;
+    }
+
+    /*
+        * Copy of the value of slot i
+        * @param i slot index, slots of all arrays numbered in a row
+        * @return value
+    */
+    V value(size_t i) const {
+        return SnapshotValue<V>::restore(values()[i], heap());
+    }
+};
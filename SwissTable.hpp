@@ -0,0 +1,406 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "./HashTable.hpp"
+#include "./HashFunctions.hpp"
+
+template <typename K, typename V, typename Hash = WyMixHash<K>>
+class SwissTable : public HashTable<K, V> {
+ private:
+    // One control byte per slot: EMPTY, DELETED or, for a full slot,
+    // the low 7 bits of the key's hash (H2). Probes scan a whole group of
+    // control bytes at once and only touch `slots` on an H2 match.
+    int8_t* ctrl;
+    std::pair<K, V>* slots;
+    size_t capacity;  // power of two, multiple of GROUP_WIDTH
+    size_t numElements;
+    size_t numDeleted;
+    Hash hasher;
+
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t GROUP_WIDTH = 16;
+
+    /*
+        * View of GROUP_WIDTH control bytes answering "which slots match"
+        * queries as bitmasks, bit i standing for the i-th slot of the group
+    */
+    class Group {
+     private:
+#if defined(__SSE2__)
+        __m128i bytes;
+#else
+        int8_t bytes[GROUP_WIDTH];
+#endif
+
+     public:
+        explicit Group(const int8_t* pos) {
+#if defined(__SSE2__)
+            bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#else
+            std::memcpy(bytes, pos, GROUP_WIDTH);
+#endif
+        }
+
+        /*
+            * Find slots whose control byte equals given byte
+            * @param h2 control byte to look for
+            * @return bitmask of matching slots
+        */
+        uint32_t match(int8_t h2) const {
+#if defined(__SSE2__)
+            return _mm_movemask_epi8(
+             _mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes));
+#else
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+                if (bytes[i] == h2) mask |= 1u << i;
+            }
+            return mask;
+#endif
+        }
+
+        /*
+            * Find empty slots
+            * @return bitmask of empty slots
+        */
+        uint32_t matchEmpty() const {
+            return match(EMPTY);
+        }
+
+        /*
+            * Find empty or deleted slots, the only negative bytes above -1
+            * @return bitmask of free slots
+        */
+        uint32_t matchFree() const {
+#if defined(__SSE2__)
+            return _mm_movemask_epi8(
+             _mm_cmpgt_epi8(_mm_set1_epi8(-1), bytes));
+#else
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+                if (bytes[i] < -1) mask |= 1u << i;
+            }
+            return mask;
+#endif
+        }
+    };
+
+    /*
+        * Control byte stored for a full slot
+        * @param h hash of the key
+        * @return H2 part of the hash
+    */
+    static int8_t h2(uint64_t h) {
+        return static_cast<int8_t>(h & 0x7F);
+    }
+
+    /*
+        * First group of the probe sequence
+        * @param h hash of the key
+        * @return group index
+    */
+    size_t firstGroup(uint64_t h) const {
+        return static_cast<size_t>(h >> 7) & (capacity / GROUP_WIDTH - 1);
+    }
+
+    /*
+        * Find slot holding key. Groups are visited in triangular order,
+        * which reaches every group of a power-of-two table
+        * @param key key to search for
+        * @return slot index or capacity if key not found
+    */
+    size_t find(const K& key) const {
+        uint64_t h = hasher(key);
+        size_t groupMask = capacity / GROUP_WIDTH - 1;
+        size_t group = firstGroup(h);
+        for (size_t step = 0; step <= groupMask; ++step) {
+            size_t base = group * GROUP_WIDTH;
+            Group g(ctrl + base);
+            for (uint32_t m = g.match(h2(h)); m; m &= m - 1) {
+                size_t index = base + __builtin_ctz(m);
+                if (slots[index].first == key)
+                    return index;
+            }
+            if (g.matchEmpty())
+                return capacity;
+            group = (group + step + 1) & groupMask;
+        }
+        return capacity;
+    }
+
+    /*
+        * Find first empty or deleted slot of the probe sequence
+        * @param h hash of the key
+        * @return slot index
+    */
+    size_t findFree(uint64_t h) const {
+        size_t groupMask = capacity / GROUP_WIDTH - 1;
+        size_t group = firstGroup(h);
+        for (size_t step = 0;; ++step) {
+            size_t base = group * GROUP_WIDTH;
+            uint32_t m = Group(ctrl + base).matchFree();
+            if (m)
+                return base + __builtin_ctz(m);
+            group = (group + step + 1) & groupMask;
+        }
+    }
+
+    /*
+        * Move every element into freshly allocated arrays
+        * @param newCapacity number of slots of the new table
+    */
+    void rehash(size_t newCapacity) {
+        int8_t* oldCtrl = ctrl;
+        std::pair<K, V>* oldSlots = slots;
+        size_t oldCapacity = capacity;
+        allocate(newCapacity);
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] >= 0) {
+                uint64_t h = hasher(oldSlots[i].first);
+                size_t index = findFree(h);
+                ctrl[index] = h2(h);
+                slots[index] = std::move(oldSlots[i]);
+            }
+        }
+        delete[] oldCtrl;
+        delete[] oldSlots;
+    }
+
+    /*
+        * Allocate empty arrays of given capacity
+        * @param newCapacity number of slots
+    */
+    void allocate(size_t newCapacity) {
+        capacity = newCapacity;
+        numDeleted = 0;
+        ctrl = new int8_t[capacity];
+        std::memset(ctrl, EMPTY, capacity);
+        slots = new std::pair<K, V>[capacity];
+    }
+
+    /*
+        * Maximum number of full and deleted slots before rehashing
+        * @return 7/8 of capacity
+    */
+    size_t maxUsed() const {
+        return capacity - capacity / 8;
+    }
+
+ public:
+    /*
+        * Constructor
+        * @param size minimal number of slots, rounded up to a power of two
+    */
+    explicit SwissTable(size_t size = 101) : numElements(0) {
+        allocate(roundUpToPowerOfTwo(size, GROUP_WIDTH));
+    }
+
+    /*
+        * Copy constructor
+        * @param other SwissTable object to copy
+    */
+    SwissTable(const SwissTable& other) {
+        numElements = other.numElements;
+        allocate(other.capacity);
+        numDeleted = other.numDeleted;
+        std::memcpy(ctrl, other.ctrl, capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                slots[i] = other.slots[i];
+            }
+        }
+    }
+
+    /*
+        * Insert key-value pair, replacing the value of an existing key
+        * @param key key to insert
+        * @param value value to insert
+    */
+    void insert(const K& key, const V& value) override {
+        size_t index = find(key);
+        if (index != capacity) {
+            slots[index].second = value;
+            return;
+        }
+        if (numElements + numDeleted + 1 > maxUsed()) {
+            // Only drop tombstones when they are what fills the table
+            rehash(numElements + 1 > maxUsed() / 2 ? capacity * 2 : capacity);
+        }
+        uint64_t h = hasher(key);
+        index = findFree(h);
+        if (ctrl[index] == DELETED)
+            --numDeleted;
+        ctrl[index] = h2(h);
+        slots[index] = std::make_pair(key, value);
+        ++numElements;
+    }
+
+    /*
+        * Insert many key-value pairs at once. The table grows once to fit
+        * all of them, then the pairs are inserted one by one: probe
+        * sequences jump between groups across the whole table, so it
+        * cannot be split into independent parts.
+        * @param keys keys to insert
+        * @param values values to insert, values[i] belongs to keys[i]
+        * @param count number of pairs
+    */
+    void bulkLoad(const K* keys, const V* values, size_t count) override {
+        size_t newCapacity = capacity;
+        while (numElements + count > newCapacity - newCapacity / 8) {
+            newCapacity *= 2;
+        }
+        if (newCapacity != capacity)
+            rehash(newCapacity);
+        for (size_t i = 0; i < count; ++i) {
+            insert(keys[i], values[i]);
+        }
+    }
+
+    /*
+        * Search for key in hash table
+        * @param key key to search for
+        * @return value associated with key
+        * @throws std::out_of_range if key not found
+    */
+    V search(const K& key) override {
+        size_t index = find(key);
+        if (index == capacity)
+            throw std::out_of_range("Key not found");
+        return slots[index].second;
+    }
+
+    /*
+        * Remove key from hash table. A slot whose group still has an empty
+        * slot becomes empty again, since no probe ever continues past
+        * such a group; otherwise it becomes a tombstone.
+        * @param key key to remove
+        * @throws std::out_of_range if key not found
+    */
+    void remove(const K& key) override {
+        size_t index = find(key);
+        if (index == capacity)
+            throw std::out_of_range("Key not found");
+        size_t base = index & ~(GROUP_WIDTH - 1);
+        if (Group(ctrl + base).matchEmpty()) {
+            ctrl[index] = EMPTY;
+        } else {
+            ctrl[index] = DELETED;
+            ++numDeleted;
+        }
+        slots[index].second = V();
+        --numElements;
+    }
+
+    /*
+        * Check if key exists in hash table
+        * @param key key to check
+        * @return true if key exists, false otherwise
+    */
+    bool exists(const K& key) override {
+        return find(key) != capacity;
+    }
+
+    /*
+        * Get number of elements in hash table
+        * @return number of elements
+    */
+    size_t size() override {
+        return numElements;
+    }
+
+    /*
+        * Check if hash table is empty
+        * @return true if hash table is empty, false otherwise
+    */
+    bool empty() override {
+        return numElements == 0;
+    }
+
+    /*
+        * Print all keys in hash table
+    */
+    void keys() override {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                std::cout << slots[i].first << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Print all values in hash table
+    */
+    void values() override {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                std::cout << slots[i].second << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Get load factor of hash table
+        * @return load factor
+    */
+    float getLoadFactor() override {
+        return static_cast<float>(numElements)
+         / static_cast<float>(capacity);
+    }
+
+    /*
+        * Gather statistics. A probe here reads one group of control bytes,
+        * so probe lengths count groups visited.
+        * @return statistics
+    */
+    TableStats stats() override {
+        TableStats stats;
+        stats.elements = numElements;
+        stats.capacity = capacity;
+        stats.loadFactor = getLoadFactor();
+        stats.tombstones = numDeleted;
+        stats.bytesUsed = capacity * (1 + sizeof(std::pair<K, V>));
+        size_t groupMask = capacity / GROUP_WIDTH - 1;
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] < 0)
+                continue;
+            size_t group = firstGroup(hasher(slots[i].first));
+            size_t step = 0;
+            while (group != i / GROUP_WIDTH) {
+                group = (group + step + 1) & groupMask;
+                ++step;
+            }
+            countInHistogram(stats.probeLengths, step);
+        }
+        return stats;
+    }
+
+    /*
+        * Print all key-value pairs in hash table
+    */
+    void print() override {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                std::cout << "Key: " << slots[i].first <<
+                 ", Value: " << slots[i].second << std::endl;
+            } else {
+                std::cout << (ctrl[i] == EMPTY ? "Empty" : "Deleted")
+                 << std::endl;
+            }
+        }
+    }
+
+    /*
+        * Destructor
+    */
+    ~SwissTable() override {
+        delete[] ctrl;
+        delete[] slots;
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/*
+    * Shape of a hash table as returned by stats(): how full it is, what
+    * it costs in memory and how far lookups have to go. Gathering it
+    * walks every slot or bucket once, so it is meant for tuning and
+    * monitoring, not for hot paths. Histograms a table does not have
+    * stay empty.
+*/
+struct TableStats {
+    size_t elements = 0;
+    size_t capacity = 0;  // slots, buckets for closed addressing
+    float loadFactor = 0;
+    size_t tombstones = 0;  // deleted slots still taking up room
+    size_t bytesUsed = 0;  // slots, buckets and nodes; not value heap memory
+
+    // Open addressing and swiss tables: element i counts keys a lookup
+    // finds after i + 1 probes (groups for swiss tables)
+    std::vector<size_t> probeLengths;
+
+    // Cuckoo hashing: element i counts inserts since construction that
+    // moved i stored keys to make room
+    std::vector<size_t> displacementChains;
+    size_t evictions = 0;  // stored keys moved by those inserts
+    size_t rehashes = 0;
+
+    // Closed addressing and bucketized cuckoo hashing: element i counts
+    // buckets holding i keys
+    std::vector<size_t> bucketOccupancy;
+    // Closed addressing: element i counts buckets whose tree has height
+    // i, 0 for buckets still stored inline
+    std::vector<size_t> treeHeights;
+};
+
+/*
+    * Count one value in a histogram indexed by value
+    * @param histogram histogram to update, grown as needed
+    * @param value value to count
+*/
+inline void countInHistogram(std::vector<size_t>& histogram, size_t value) {
+    if (histogram.size() <= value)
+        histogram.resize(value + 1, 0);
+    ++histogram[value];
+}
+
+/*
+    * Add the counts of another histogram indexed by value
+    * @param histogram histogram to update, grown as needed
+    * @param other histogram to add
+*/
+inline void mergeHistogram(std::vector<size_t>& histogram,
+ const std::vector<size_t>& other) {
+    if (histogram.size() < other.size())
+        histogram.resize(other.size(), 0);
+    for (size_t i = 0; i < other.size(); ++i) {
+        histogram[i] += other[i];
+    }
+}
+
+/*
+    * Mean of a histogram indexed by value
+    * @param histogram histogram to read
+    * @return mean value, 0 for an empty histogram
+*/
+inline double histogramMean(const std::vector<size_t>& histogram) {
+    double total = 0;
+    double count = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        total += static_cast<double>(i) * histogram[i];
+        count += histogram[i];
+    }
+    return count ? total / count : 0;
+}
+
+/*
+    * Value below which a fraction of the counted values lie
+    * @param histogram histogram indexed by value
+    * @param p fraction in [0, 1]
+    * @return value, 0 for an empty histogram
+*/
+inline size_t histogramPercentile(const std::vector<size_t>& histogram,
+ double p) {
+    size_t count = 0;
+    for (size_t n : histogram) {
+        count += n;
+    }
+    if (count == 0)
+        return 0;
+    size_t rank = static_cast<size_t>(p * (count - 1)) + 1;
+    size_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen >= rank)
+            return i;
+    }
+    return histogram.size() - 1;
+}
+
+/*
+    * Print a one-line summary, each histogram as mean, p99 and maximum.
+    * Probe lengths are printed as probes, one more than their index.
+    * @param output stream to print to
+    * @param stats statistics to print
+    * @return output
+*/
+inline std::ostream& operator<<(std::ostream& output,
+ const TableStats& stats) {
+    output << "elements " << stats.elements << ", capacity " << stats.capacity
+     << ", load factor " << stats.loadFactor << ", tombstones "
+     << stats.tombstones << ", bytes " << stats.bytesUsed;
+    auto summary = [&](const char* name, const std::vector<size_t>& h,
+     size_t offset) {
+        if (h.empty())
+            return;
+        output << ", " << name << " mean " << histogramMean(h) + offset
+         << " p99 " << histogramPercentile(h, 0.99) + offset
+         << " max " << h.size() - 1 + offset;
+    };
+    summary("probes", stats.probeLengths, 1);
+    summary("displacements", stats.displacementChains, 0);
+    if (!stats.displacementChains.empty())
+        output << ", evictions " << stats.evictions << ", rehashes "
+         << stats.rehashes;
+    summary("bucket keys", stats.bucketOccupancy, 0);
+    summary("tree height", stats.treeHeights, 0);
+    return output;
+}
@@ -0,0 +1,394 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./Benchmark.hpp"
+#include "./HashFunctions.hpp"
+
+/*
+    * YCSB-style mixed workloads. A generator turns a mix of reads,
+    * inserts, updates and removes and a key distribution into a trace of
+    * operations ahead of time, so drawing random numbers is not timed;
+    * the trace is then replayed against a table in timed batches and
+    * reported interval by interval, which shows a table slowing down as
+    * tombstones and chains build up.
+*/
+
+/*
+    * xoshiro256** generator seeded through splitmix64. Fast, and unlike
+    * rand() the same seed gives the same sequence everywhere.
+*/
+class Xoshiro256 {
+ private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+ public:
+    using result_type = uint64_t;
+
+    /*
+        * Constructor
+        * @param seed any value, also 0
+    */
+    explicit Xoshiro256(uint64_t seed) {
+        for (uint64_t& word : state) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    /*
+        * Number in [0, bound) by multiply-shift, without a division
+        * @param bound exclusive upper bound, above 0
+        * @return number
+    */
+    uint64_t below(uint64_t bound) {
+        return static_cast<uint64_t>(
+         (static_cast<__uint128_t>((*this)()) * bound) >> 64);
+    }
+
+    /*
+        * Number in [0, 1) with 53 random bits
+        * @return number
+    */
+    double unit() {
+        return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+};
+
+/*
+    * Zipfian ranks by the method of Gray et al., as in YCSB. Rank 0 is the
+    * most popular. The item count may grow between draws; the zeta sum is
+    * then extended by the new items only.
+*/
+class ZipfianGenerator {
+ private:
+    double theta;
+    double alpha;
+    double zeta2;
+    double zetaN;
+    double eta;
+    size_t items;
+
+    void grow(size_t count) {
+        for (size_t i = items + 1; i <= count; ++i) {
+            zetaN += 1 / std::pow(static_cast<double>(i), theta);
+        }
+        items = count;
+        eta = (1 - std::pow(2.0 / items, 1 - theta)) / (1 - zeta2 / zetaN);
+    }
+
+ public:
+    /*
+        * Constructor
+        * @param items number of items to draw from at first
+        * @param theta skew in (0, 1), YCSB uses 0.99
+        * @throws std::invalid_argument if theta is out of range
+    */
+    ZipfianGenerator(size_t items, double theta)
+        : theta(theta), zetaN(0), eta(0), items(0) {
+        if (!(theta > 0 && theta < 1))
+            throw std::invalid_argument("Zipfian theta must be in (0, 1)");
+        alpha = 1 / (1 - theta);
+        zeta2 = 1 + std::pow(0.5, theta);
+        grow(items);
+    }
+
+    /*
+        * Draw a rank
+        * @param rng random number generator
+        * @param count number of items, at least 1
+        * @return rank in [0, count)
+    */
+    size_t next(Xoshiro256& rng, size_t count) {
+        if (count > items)
+            grow(count);
+        if (count < 2)
+            return 0;
+        double u = rng.unit();
+        double uz = u * zetaN;
+        if (uz < 1)
+            return 0;
+        if (uz < zeta2)
+            return 1;
+        size_t rank = static_cast<size_t>(
+         count * std::pow(eta * u - eta + 1, alpha));
+        return rank < count ? rank : count - 1;
+    }
+};
+
+// How the record an operation works on is chosen
+enum class KeyDistribution {
+    Uniform,
+    Zipfian,  // popular records scattered over the whole key range
+    Latest,  // Zipfian over age, the newest records are the most popular
+};
+
+/*
+    * Mix of operations of a workload. The four ratios add up to 1.
+*/
+struct WorkloadSpec {
+    std::string name;
+    double read;
+    double insert;
+    double update;
+    double remove;
+    KeyDistribution distribution;
+    double missRatio;  // part of the reads asking for keys never inserted
+    double theta = 0.99;
+};
+
+/*
+    * The YCSB core workloads without scans, and a churn workload that
+    * inserts and removes at the same rate to leave tombstones behind
+    * @return workloads
+*/
+inline std::vector<WorkloadSpec> standardWorkloads() {
+    return {
+        {"A", 0.5, 0, 0.5, 0, KeyDistribution::Zipfian, 0},
+        {"B", 0.95, 0, 0.05, 0, KeyDistribution::Zipfian, 0},
+        {"C", 1, 0, 0, 0, KeyDistribution::Zipfian, 0},
+        {"D", 0.95, 0.05, 0, 0, KeyDistribution::Latest, 0},
+        {"churn", 0.5, 0.25, 0, 0.25, KeyDistribution::Uniform, 0.2},
+    };
+}
+
+enum class OperationType : uint8_t {
+    Read,
+    Insert,
+    Update,
+    Remove,
+};
+
+struct WorkloadOperation {
+    OperationType type;
+    int key;
+};
+
+/*
+    * Builds the trace of a workload. Record i has key i + 1; the first
+    * records are loaded before the trace runs and inserts append new
+    * ones. Updates and removes only pick records that are still stored,
+    * reads may pick removed ones and miss.
+*/
+class WorkloadGenerator {
+ private:
+    WorkloadSpec spec;
+    Xoshiro256 rng;
+    ZipfianGenerator zipfian;
+    size_t loaded;
+    size_t records;  // inserted so far, removed ones included
+    size_t live;
+    std::vector<bool> removed;
+
+    size_t pick() {
+        switch (spec.distribution) {
+        case KeyDistribution::Uniform:
+            return rng.below(records);
+        case KeyDistribution::Zipfian:
+            return remixHash(zipfian.next(rng, records)) % records;
+        default:
+            return records - 1 - zipfian.next(rng, records);
+        }
+    }
+
+    // Chosen like pick(), falling back to the next stored record when a
+    // few draws only hit removed ones
+    size_t pickLive() {
+        size_t record = pick();
+        for (int attempt = 0; attempt < 8 && removed[record]; ++attempt) {
+            record = pick();
+        }
+        while (removed[record]) {
+            record = record + 1 < records ? record + 1 : 0;
+        }
+        return record;
+    }
+
+ public:
+    // Missed reads ask for keys from here on, far above any record
+    static constexpr int MISS_KEY_BASE = 1500000000;
+
+    /*
+        * Constructor
+        * @param spec workload
+        * @param records number of records loaded before the trace runs
+        * @param seed seed of the random number generator
+        * @throws std::invalid_argument if the ratios do not add up to 1,
+        * a ratio is negative or no record is loaded
+    */
+    WorkloadGenerator(const WorkloadSpec& spec, size_t records, uint64_t seed)
+        : spec(spec), rng(seed), zipfian(records, spec.theta),
+          loaded(records), records(records), live(records),
+          removed(records, false) {
+        double total = spec.read + spec.insert + spec.update + spec.remove;
+        if (spec.read < 0 || spec.insert < 0 || spec.update < 0
+         || spec.remove < 0 || std::fabs(total - 1) > 1e-9)
+            throw std::invalid_argument("Workload " + spec.name
+             + ": operation ratios must be positive and add up to 1");
+        if (spec.missRatio < 0 || spec.missRatio > 1)
+            throw std::invalid_argument("Workload " + spec.name
+             + ": miss ratio must be in [0, 1]");
+        if (records == 0 || records >= MISS_KEY_BASE)
+            throw std::invalid_argument("Workload " + spec.name
+             + ": record count out of range");
+    }
+
+    static int keyOf(size_t record) {
+        return static_cast<int>(record + 1);
+    }
+
+    /*
+        * Keys to load before the trace runs
+        * @return keys of the first records
+    */
+    std::vector<int> initialKeys() const {
+        std::vector<int> keys(loaded);
+        for (size_t i = 0; i < loaded; ++i) {
+            keys[i] = keyOf(i);
+        }
+        return keys;
+    }
+
+    /*
+        * Draw the next operations. Updates and removes become inserts
+        * while every record is removed.
+        * @param count number of operations
+        * @return operations in the order to run them
+        * @throws std::length_error if inserts run into the missed keys
+    */
+    std::vector<WorkloadOperation> generate(size_t count) {
+        std::vector<WorkloadOperation> trace(count);
+        for (WorkloadOperation& operation : trace) {
+            double u = rng.unit();
+            if (u < spec.read) {
+                operation.type = OperationType::Read;
+                if (rng.unit() < spec.missRatio)
+                    operation.key = MISS_KEY_BASE
+                     + static_cast<int>(rng.below(500000000));
+                else
+                    operation.key = keyOf(pick());
+            } else if (u < spec.read + spec.insert || live == 0) {
+                if (records + 1 >= MISS_KEY_BASE)
+                    throw std::length_error("Workload " + spec.name
+                     + ": out of keys");
+                operation.type = OperationType::Insert;
+                operation.key = keyOf(records++);
+                removed.push_back(false);
+                ++live;
+            } else if (u < spec.read + spec.insert + spec.update) {
+                operation.type = OperationType::Update;
+                operation.key = keyOf(pickLive());
+            } else {
+                size_t record = pickLive();
+                operation.type = OperationType::Remove;
+                operation.key = keyOf(record);
+                removed[record] = true;
+                --live;
+            }
+        }
+        return trace;
+    }
+};
+
+/*
+    * Result of one interval of a replayed trace
+*/
+struct WorkloadInterval {
+    size_t operations;
+    uint64_t picoseconds;  // time spent in the operations
+    LatencyHistogram batchMeans;  // mean time per operation of every batch
+    size_t hits;
+    size_t misses;
+    size_t size;  // elements stored at the end of the interval
+    float loadFactor;
+
+    double throughput() const {
+        return picoseconds ? operations * 1e12 / picoseconds : 0;
+    }
+};
+
+/*
+    * Replay a trace against a table loaded with the initial keys of its
+    * generator. Reads are single key searchBatch calls, so missing keys do
+    * not throw. An update is a remove followed by an insert, since open
+    * addressing inserts do not replace a stored key.
+    * @param table table to run the trace on
+    * @param trace operations from WorkloadGenerator::generate
+    * @param value value stored by inserts and updates
+    * @param intervalOperations operations per reported interval
+    * @param batchSize operations per timed batch
+    * @return one result per interval, the last one possibly shorter
+*/
+template <typename Table, typename V>
+std::vector<WorkloadInterval> runWorkload(Table& table,
+ const std::vector<WorkloadOperation>& trace, const V& value,
+ size_t intervalOperations, size_t batchSize) {
+    std::vector<WorkloadInterval> intervals;
+    V found;
+    for (size_t start = 0; start < trace.size();
+     start += intervalOperations) {
+        size_t end = std::min(trace.size(), start + intervalOperations);
+        WorkloadInterval interval = {end - start, 0, LatencyHistogram(),
+         0, 0, 0, 0};
+        for (size_t first = start; first < end; first += batchSize) {
+            size_t last = std::min(end, first + batchSize);
+            uint64_t ps = timeBatch(last - first, [&]() {
+                for (size_t i = first; i < last; ++i) {
+                    const WorkloadOperation& operation = trace[i];
+                    switch (operation.type) {
+                    case OperationType::Read: {
+                        bool hit = false;
+                        table.searchBatch(&operation.key, 1, &found, &hit);
+                        interval.hits += hit;
+                        interval.misses += !hit;
+                        break;
+                    }
+                    case OperationType::Insert:
+                        table.insert(operation.key, value);
+                        break;
+                    case OperationType::Update:
+                        table.remove(operation.key);
+                        table.insert(operation.key, value);
+                        break;
+                    case OperationType::Remove:
+                        table.remove(operation.key);
+                        break;
+                    }
+                }
+            });
+            interval.batchMeans.record(ps);
+            interval.picoseconds += ps * (last - first);
+        }
+        interval.size = table.size();
+        interval.loadFactor = table.getLoadFactor();
+        intervals.push_back(std::move(interval));
+    }
+    return intervals;
+}
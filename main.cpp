@@ -6,153 +6,1114 @@
 #include <string>
 #include <filesystem>
 #include <chrono>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <random>
 
 #include "./OpenAddressing.hpp"
+#include "./ConcurrentOpenAddressing.hpp"
 #include "./ClosedAddressingWithBST.hpp"
+#include "./ConcurrentClosedAddressingWithBST.hpp"
 #include "./CuckooHashing.hpp"
+#include "./ConcurrentCuckooHashing.hpp"
+#include "./BucketizedCuckooHashing.hpp"
+#include "./SwissTable.hpp"
+#include "./DatasetLoader.hpp"
+#include "./Benchmark.hpp"
+#include "./Workload.hpp"
 
 namespace fs = std::filesystem;
 
 OpenAddressing<int, std::string> *openAddressing;
-ClosedAddressingWithBST<int, std::string> *closedAddressing;
-CuckooHashing<int, std::string> *cuckooHashing;
+HashTable<int, std::string> *dispatchTable;
+
+void readEntries(std::string file, std::vector<int> &keys, std::vector<std::string> &values) {
+    Dataset dataset = loadDataset(file);
+    keys = std::move(dataset.keys);
+    values.assign(dataset.values.begin(), dataset.values.end());
+}
+
+// The line by line reader used before DatasetLoader, kept as a baseline
+void readEntriesGetline(std::string file, std::vector<int> &keys, std::vector<std::string> &values) {
+    std::ifstream input(file);
+    std::string line;
+    keys.clear();
+    values.clear();
+    while (std::getline(input, line)) {
+        keys.push_back(std::stoi(line.substr(0, line.find(" "))));
+        values.push_back(line.substr(line.find(" ") + 1));
+    }
+}
+
+template <typename Structure>
+int populateStructureAndReturnKeyToRemove(Structure *structure, const std::vector<int> &keys, const std::vector<std::string> &values) {
+    structure->bulkLoad(keys.data(), values.data(), keys.size());
+    bool found = false;
+    int tempKey = -5;
+    Xoshiro256 rng(keys.size());
+    while (!found) {
+        tempKey = static_cast<int>(rng.below(1000000)) + 1;
+        found = structure->exists(tempKey);
+    }
+    return tempKey;
+}
+
+template <typename Structure>
+int populateStructureAndReturnKeyToRemove(Structure *structure, std::string file) {
+    std::vector<int> keys;
+    std::vector<std::string> values;
+    std::cout << "Populating structure with data from " << file << "\n";
+    readEntries(file, keys, values);
+    int keyToRemove = populateStructureAndReturnKeyToRemove(structure, keys, values);
+    std::cout << "Structure populated\n";
+    return keyToRemove;
+}
 
 template <typename Structure>
-uint64_t performInsertion(Structure *structure, int key, std::string value) {
+uint64_t timeMissedLookups(Structure *structure, int count) {
+    // Dataset keys never exceed 1000000
+    int found = 0;
     auto start = std::chrono::high_resolution_clock::now();
-    structure->insert(key, value);
+    for (int j = 0; j < count; j++) {
+        found += structure->exists(2000000 + j);
+    }
     auto end = std::chrono::high_resolution_clock::now();
-    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-            
-    std::cout << " Time: " << time << "ns\n";
-    return time;
+    if (found != 0) {
+        std::cout << "Unexpected hits in missed lookups\n";
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+std::vector<int> readKeys(std::string file) {
+    return loadDataset(file).keys;
 }
 
 template <typename Structure>
-uint64_t performRemoval(Structure *structure, int key) {
+uint64_t timeSearchPass(Structure *structure, const std::vector<int> &keys) {
+    size_t checksum = 0;
     auto start = std::chrono::high_resolution_clock::now();
-    structure->remove(key);
+    for (int key : keys) {
+        checksum += structure->search(key).size();
+    }
     auto end = std::chrono::high_resolution_clock::now();
-    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-    std::cout << " Time: " << time << "ns\n";
-    return time;
+    if (checksum == 0) {
+        std::cout << "Empty search results\n";
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
 }
 
 template <typename Structure>
-int populateStructureAndReturnKeyToRemove(Structure *structure, std::string file) {
-    std::ifstream input(file);
-    std::string line;
-    std::cout << "Populating structure with data from " << file << "\n";
-    while (std::getline(input, line)) {
-        int key = std::stoi(line.substr(0, line.find(" ")));
-        std::string value = line.substr(line.find(" ") + 1);
-        structure->insert(key, value);
+void compareLookups(std::ofstream &output, std::string name, std::string dataDir, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        uint64_t timeSearch = 0;
+        uint64_t timeExists = 0;
+        uint64_t searches = 0;
+        for (int d = 0; d < setCount; d++) {
+            std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+            Structure *structure = new Structure(size*2);
+            populateStructureAndReturnKeyToRemove(structure, filename);
+            std::vector<int> keys = readKeys(filename);
+            timeSearch += timeSearchPass(structure, keys);
+            timeExists += timeMissedLookups(structure, 1000);
+            searches += keys.size();
+            delete structure;
+        }
+        uint64_t searchNs = searches ? timeSearch / searches : 0;
+        output << "searchPass;" << name << ";" << size << ";" << searchNs << "\n";
+        output << "existsMiss;" << name << ";" << size << ";" << timeExists / (1000 * setCount) << "\n";
+        std::cout << "LOOKUPS | " << name << " size " << size << ": search " << searchNs << " ns, missed lookup " << timeExists / (1000 * setCount) << " ns\n";
     }
-    std::cout << "Structure populated\n";
-    bool found = false;
-    int tempKey = -5;
-    while (!found) {
-        tempKey = rand()%1000000 + 1;
-        found = structure->exists(tempKey);
+}
+
+template <typename Structure>
+void compareBatchLookups(std::ofstream &output, std::string name, std::string dataDir, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        uint64_t timeSearchLoop = 0;
+        uint64_t timeSearchBatch = 0;
+        uint64_t timeExistsLoop = 0;
+        uint64_t timeExistsBatch = 0;
+        uint64_t lookups = 0;
+        for (int d = 0; d < setCount; d++) {
+            std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+            Structure *structure = new Structure(size*2);
+            populateStructureAndReturnKeyToRemove(structure, filename);
+            std::vector<int> keys = readKeys(filename);
+            // Every other key misses, dataset keys never exceed 1000000
+            std::vector<int> mixed;
+            for (size_t j = 0; j < keys.size(); j++) {
+                mixed.push_back(keys[j]);
+                mixed.push_back(2000000 + j);
+            }
+            std::vector<std::string> values(mixed.size());
+            std::unique_ptr<bool[]> found(new bool[mixed.size()]);
+            size_t hits = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t j = 0; j < mixed.size(); j++) {
+                found[j] = structure->exists(mixed[j]);
+                if (found[j]) {
+                    values[j] = structure->search(mixed[j]);
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            timeSearchLoop += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            hits += structure->searchBatch(mixed.data(), mixed.size(), values.data(), found.get());
+            end = std::chrono::high_resolution_clock::now();
+            timeSearchBatch += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t j = 0; j < mixed.size(); j++) {
+                hits += structure->exists(mixed[j]);
+            }
+            end = std::chrono::high_resolution_clock::now();
+            timeExistsLoop += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            structure->existsBatch(mixed.data(), mixed.size(), found.get());
+            end = std::chrono::high_resolution_clock::now();
+            timeExistsBatch += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            for (size_t j = 0; j < mixed.size(); j++) {
+                hits += found[j];
+            }
+            if (hits != 3 * keys.size()) {
+                std::cout << "Unexpected batch lookup results\n";
+            }
+            lookups += mixed.size();
+            delete structure;
+        }
+        uint64_t searchLoopNs = lookups ? timeSearchLoop / lookups : 0;
+        uint64_t searchBatchNs = lookups ? timeSearchBatch / lookups : 0;
+        uint64_t existsLoopNs = lookups ? timeExistsLoop / lookups : 0;
+        uint64_t existsBatchNs = lookups ? timeExistsBatch / lookups : 0;
+        output << "searchLoop;" << name << ";" << size << ";" << searchLoopNs << "\n";
+        output << "searchBatch;" << name << ";" << size << ";" << searchBatchNs << "\n";
+        output << "existsLoop;" << name << ";" << size << ";" << existsLoopNs << "\n";
+        output << "existsBatch;" << name << ";" << size << ";" << existsBatchNs << "\n";
+        std::cout << "BATCH_LOOKUPS | " << name << " size " << size << ": search " << searchLoopNs << " ns single, " << searchBatchNs << " ns batched; exists " << existsLoopNs << " ns single, " << existsBatchNs << " ns batched\n";
+    }
+}
+
+void compareLoaders(std::ofstream &output, std::string dataDir, int size, int dataSets[], int setCount) {
+    std::vector<std::string> paths;
+    for (int d = 0; d < setCount; d++) {
+        paths.push_back(dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt");
+    }
+    size_t lines = 0;
+    size_t checksum = 0;
+
+    // Every file through the old line by line reader
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const std::string &path : paths) {
+        std::vector<int> keys;
+        std::vector<std::string> values;
+        readEntriesGetline(path, keys, values);
+        lines += keys.size();
+        checksum += keys.empty() ? 0 : keys.back() + values.back().size();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    uint64_t timeGetline = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    // Every file mapped and parsed in place, one after another
+    size_t mappedChecksum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string &path : paths) {
+        Dataset dataset = loadDataset(path);
+        mappedChecksum += dataset.keys.empty() ? 0 : dataset.keys.back() + dataset.values.back().size();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    uint64_t timeMapped = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    // The whole directory at once, one thread per file
+    size_t parallelChecksum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<Dataset> datasets = loadDatasets(paths);
+    end = std::chrono::high_resolution_clock::now();
+    uint64_t timeParallel = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    for (const Dataset &dataset : datasets) {
+        parallelChecksum += dataset.keys.empty() ? 0 : dataset.keys.back() + dataset.values.back().size();
+    }
+
+    if (mappedChecksum != checksum || parallelChecksum != checksum) {
+        std::cout << "Loaders disagree on " << dataDir << " size " << size << "\n";
+    }
+    uint64_t getlineNs = lines ? timeGetline / lines : 0;
+    uint64_t mappedNs = lines ? timeMapped / lines : 0;
+    uint64_t parallelNs = lines ? timeParallel / lines : 0;
+    output << "loadGetline;dataset;" << size << ";" << getlineNs << "\n";
+    output << "loadMapped;dataset;" << size << ";" << mappedNs << "\n";
+    output << "loadMappedParallel;dataset;" << size << ";" << parallelNs << "\n";
+    std::cout << "LOADER | " << setCount << " files of size " << size << ": getline " << getlineNs << " ns, mapped " << mappedNs << " ns, mapped with a thread per file " << parallelNs << " ns per line\n";
+}
+
+template <typename Structure, typename Snapshot = void>
+void compareSnapshots(std::ofstream &output, std::string name, std::string dataDir, int size, int dataSets[], int setCount) {
+    std::string path = (std::filesystem::temp_directory_path() / ("snapshot_" + name + ".bin")).string();
+    uint64_t timeBuild = 0;
+    uint64_t timeSave = 0;
+    uint64_t timeLoad = 0;
+    uint64_t timeOpen = 0;
+    bool same = true;
+    for (int d = 0; d < setCount; d++) {
+        std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<int> keys;
+        std::vector<std::string> values;
+        readEntries(filename, keys, values);
+        Structure *built = new Structure(size*2);
+        built->bulkLoad(keys.data(), values.data(), keys.size());
+        auto end = std::chrono::high_resolution_clock::now();
+        timeBuild += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        built->save(path);
+        end = std::chrono::high_resolution_clock::now();
+        timeSave += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        Structure *loaded = new Structure(101);
+        start = std::chrono::high_resolution_clock::now();
+        loaded->load(path);
+        end = std::chrono::high_resolution_clock::now();
+        timeLoad += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        same = same && loaded->size() == built->size();
+        for (size_t j = 0; same && j < keys.size(); j++) {
+            same = loaded->search(keys[j]) == built->search(keys[j]);
+        }
+        if constexpr (!std::is_void<Snapshot>::value) {
+            start = std::chrono::high_resolution_clock::now();
+            Snapshot view(path);
+            end = std::chrono::high_resolution_clock::now();
+            timeOpen += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            same = same && view.size() == built->size() && !view.exists(2000000);
+            for (size_t j = 0; same && j < keys.size(); j++) {
+                same = view.search(keys[j]) == built->search(keys[j]);
+            }
+        }
+        delete built;
+        delete loaded;
+    }
+    std::filesystem::remove(path);
+    if (!same) {
+        std::cout << "Snapshot of " << name << " differs from the saved table\n";
+    }
+    output << "snapshotBuildFromText;" << name << ";" << size << ";" << timeBuild / setCount << "\n";
+    output << "snapshotSave;" << name << ";" << size << ";" << timeSave / setCount << "\n";
+    output << "snapshotLoad;" << name << ";" << size << ";" << timeLoad / setCount << "\n";
+    std::cout << "SNAPSHOT | " << name << " size " << size << ": build from text " << timeBuild / setCount << " ns, save " << timeSave / setCount << " ns, load " << timeLoad / setCount << " ns";
+    if constexpr (!std::is_void<Snapshot>::value) {
+        output << "snapshotOpen;" << name << ";" << size << ";" << timeOpen / setCount << "\n";
+        std::cout << ", open mapped " << timeOpen / setCount << " ns";
+    }
+    std::cout << " per table\n";
+}
+
+template <typename Structure>
+void compareBulkLoad(std::ofstream &output, std::string name, std::string dataDir, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        uint64_t timeLoop = 0;
+        uint64_t timeBulk = 0;
+        uint64_t entries = 0;
+        for (int d = 0; d < setCount; d++) {
+            std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+            std::vector<int> keys;
+            std::vector<std::string> values;
+            readEntries(filename, keys, values);
+
+            Structure *looped = new Structure(size*2);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t j = 0; j < keys.size(); j++) {
+                looped->insert(keys[j], values[j]);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            timeLoop += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            Structure *bulk = new Structure(size*2);
+            start = std::chrono::high_resolution_clock::now();
+            bulk->bulkLoad(keys.data(), values.data(), keys.size());
+            end = std::chrono::high_resolution_clock::now();
+            timeBulk += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            bool same = bulk->size() == looped->size();
+            for (size_t j = 0; same && j < keys.size(); j++) {
+                same = bulk->exists(keys[j]) && bulk->search(keys[j]) == looped->search(keys[j]);
+            }
+            if (!same) {
+                std::cout << "Bulk load differs from inserting one by one\n";
+            }
+            entries += keys.size();
+            delete looped;
+            delete bulk;
+        }
+        uint64_t loopNs = entries ? timeLoop / entries : 0;
+        uint64_t bulkNs = entries ? timeBulk / entries : 0;
+        output << "buildLoop;" << name << ";" << size << ";" << loopNs << "\n";
+        output << "bulkLoad;" << name << ";" << size << ";" << bulkNs << "\n";
+        std::cout << "BULK_LOAD | " << name << " size " << size << ": " << loopNs << " ns per insert, " << bulkNs << " ns per entry bulk loaded\n";
+    }
+}
+
+template <typename Structure>
+void compareCopies(std::ofstream &output, std::string name, std::string dataDir, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        uint64_t timeCopy = 0;
+        uint64_t timeWrite = 0;
+        for (int d = 0; d < setCount; d++) {
+            std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+            std::vector<int> keys;
+            std::vector<std::string> values;
+            readEntries(filename, keys, values);
+            Structure *structure = new Structure(size*2);
+            structure->bulkLoad(keys.data(), values.data(), keys.size());
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Structure *copy = new Structure(*structure);
+            auto end = std::chrono::high_resolution_clock::now();
+            timeCopy += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            // One insert and one remove on the copy, as the insertion and
+            // removal timings do; copy-on-write layouts pay for the copy here
+            start = std::chrono::high_resolution_clock::now();
+            copy->insert(2000000, "copy");
+            copy->remove(2000000);
+            end = std::chrono::high_resolution_clock::now();
+            timeWrite += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            bool same = copy->size() == structure->size();
+            for (size_t j = 0; same && j < keys.size(); j++) {
+                same = copy->search(keys[j]) == structure->search(keys[j]);
+            }
+            if (!same) {
+                std::cout << "Copy differs from the original table\n";
+            }
+            delete copy;
+            delete structure;
+        }
+        output << "copy;" << name << ";" << size << ";" << timeCopy / setCount << "\n";
+        output << "firstWriteAfterCopy;" << name << ";" << size << ";" << timeWrite / setCount << "\n";
+        std::cout << "COPY | " << name << " size " << size << ": " << timeCopy / setCount << " ns per table, first insert and remove " << timeWrite / setCount << " ns\n";
+    }
+}
+
+template <typename Structure>
+void compareConcurrent(std::ofstream &output, std::string name, std::string dataDir, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        for (unsigned threads : threadCounts) {
+            uint64_t timeInsert = 0;
+            uint64_t timeSearch = 0;
+            uint64_t operations = 0;
+            for (int d = 0; d < setCount; d++) {
+                std::string filename = dataDir + "/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+                std::vector<int> keys = readKeys(filename);
+                size_t keyCount = keys.size();
+                Structure *structure = new Structure(size*2);
+                std::vector<std::thread> workers;
+
+                // Every thread inserts its own share of the keys
+                auto start = std::chrono::high_resolution_clock::now();
+                for (unsigned t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t]() {
+                        for (size_t j = t; j < keyCount; j += threads) {
+                            structure->insert(keys[j], "test");
+                        }
+                    });
+                }
+                for (std::thread &worker : workers) {
+                    worker.join();
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                timeInsert += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                workers.clear();
+
+                // Every thread searches all keys, starting at its own offset
+                std::atomic<size_t> checksum(0);
+                start = std::chrono::high_resolution_clock::now();
+                for (unsigned t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t]() {
+                        size_t local = 0;
+                        size_t offset = keyCount * t / threads;
+                        for (size_t j = 0; j < keyCount; j++) {
+                            local += structure->search(keys[(offset + j) % keyCount]).size();
+                        }
+                        checksum += local;
+                    });
+                }
+                for (std::thread &worker : workers) {
+                    worker.join();
+                }
+                end = std::chrono::high_resolution_clock::now();
+                timeSearch += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+                if (checksum != 4 * keyCount * threads) {
+                    std::cout << "Unexpected concurrent search results\n";
+                }
+                operations += keyCount;
+                delete structure;
+            }
+            // Wall clock per operation, so perfect scaling divides it by threads
+            uint64_t insertNs = operations ? timeInsert / operations : 0;
+            uint64_t searchNs = operations ? timeSearch / (operations * threads) : 0;
+            output << "concurrentInsert;" << name << "Threads" << threads << ";" << size << ";" << insertNs << "\n";
+            output << "concurrentSearch;" << name << "Threads" << threads << ";" << size << ";" << searchNs << "\n";
+            std::cout << "CONCURRENT | " << name << " size " << size << ", " << threads << " threads: insert " << insertNs << " ns, search " << searchNs << " ns per operation\n";
+        }
     }
-    return tempKey;
 }
 
-int main() {
+template <typename Structure>
+void stressConcurrent(std::string name) {
+    unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+    const int perThread = 20000;
+    Structure *structure = new Structure(threads * perThread * 2);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    // Every thread writes its own keys while reading its neighbour's
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < perThread; i++) {
+                int key = t * 1000000 + i;
+                structure->insert(key, "old");
+                structure->insert(key, std::to_string(key));
+                if (i % 3 == 0) {
+                    structure->remove(key);
+                }
+                // An earlier key of this thread that was kept must stay
+                // visible while other threads move keys around
+                int kept = i / 2 - (i / 2) % 3 + 1;
+                if (kept < i && !structure->exists(t * 1000000 + kept)) {
+                    failures++;
+                }
+                int other = (t + 1) % threads * 1000000 + i / 2;
+                try {
+                    std::string value = structure->search(other);
+                    if (value != "old" && value != std::to_string(other)) {
+                        failures++;
+                    }
+                } catch (const std::exception &) {
+                    // Not inserted yet or removed, both are fine
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    size_t expected = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        for (int i = 0; i < perThread; i++) {
+            int key = t * 1000000 + i;
+            bool present = structure->exists(key);
+            if (present != (i % 3 != 0) || (present && structure->search(key) != std::to_string(key))) {
+                failures++;
+            }
+            expected += i % 3 != 0;
+        }
+    }
+    if (structure->size() != expected) {
+        failures++;
+    }
+    std::cout << "STRESS | " << name << " with " << threads << " threads: " << (failures == 0 ? "passed" : "FAILED") << "\n";
+    delete structure;
+}
+
+// Threads insert and remove fresh keys on a table far smaller than the
+// keys they go through, keeping a few live each, so a table that cannot
+// drop removed keys' slots fills up
+template <typename Structure>
+void churnConcurrent(std::string name) {
+    unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+    const int perThread = 200000;
+    const int live = 16;
+    Structure *structure = new Structure(64);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                for (int i = 0; i < perThread; i++) {
+                    int key = t * 1000000 + i;
+                    structure->insert(key, std::to_string(key));
+                    if (structure->search(key) != std::to_string(key)) {
+                        failures++;
+                    }
+                    if (i >= live) {
+                        structure->remove(key - live);
+                    }
+                }
+            } catch (const std::exception &) {
+                failures++;
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    if (structure->size() != threads * live) {
+        failures++;
+    }
+    std::cout << "CHURN | " << name << " with " << threads << " threads: " << (failures == 0 ? "passed" : "FAILED") << ", " << structure->stats() << "\n";
+    delete structure;
+}
+
+// One mutex around a whole table, the usual way to share a table that is
+// not thread-safe; the baseline for the concurrent tables
+template <typename Table>
+class GlobalLock {
+ private:
+    Table table;
+    std::mutex lock;
+
+ public:
+    explicit GlobalLock(size_t size) : table(size) {}
+    void insert(int key, const std::string &value) {
+        std::lock_guard<std::mutex> guard(lock);
+        table.insert(key, value);
+    }
+    std::string search(int key) {
+        std::lock_guard<std::mutex> guard(lock);
+        return table.search(key);
+    }
+    bool exists(int key) {
+        std::lock_guard<std::mutex> guard(lock);
+        return table.exists(key);
+    }
+    void remove(int key) {
+        std::lock_guard<std::mutex> guard(lock);
+        table.remove(key);
+    }
+    size_t size() {
+        std::lock_guard<std::mutex> guard(lock);
+        return table.size();
+    }
+};
+
+template <typename Layout, typename Hash = WyMixHash<int>>
+class LinearProbing : public OpenAddressingTable<int, std::string, Layout, Hash, LinearProbe> {
+ public:
+    explicit LinearProbing(size_t size) : OpenAddressingTable<int, std::string, Layout, Hash, LinearProbe>(0, size) {}
+};
+
+template <typename Layout, typename Hash = WyMixHash<int>>
+class RobinHoodProbing : public OpenAddressingTable<int, std::string, Layout, Hash, RobinHoodProbe> {
+ public:
+    explicit RobinHoodProbing(size_t size) : OpenAddressingTable<int, std::string, Layout, Hash, RobinHoodProbe>(3, size) {}
+};
+
+template <typename Probe>
+void compareDispatch(std::ofstream &output, int probingType, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    std::string name = "openAddressingProbingType" + std::to_string(probingType);
+    for (int s = 0; s < sizeCount; s++) {
+        int size = sizes[s];
+        // Virtual interface with run-time probing, as every table is used
+        // above; direct calls with run-time probing; direct calls with the
+        // probe sequence fixed at compile time
+        uint64_t timeSearch[3] = {0, 0, 0};
+        uint64_t timeExists[3] = {0, 0, 0};
+        uint64_t searches = 0;
+        for (int d = 0; d < setCount; d++) {
+            std::string filename = "./data1/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(size) + ".txt";
+            std::vector<int> keys = readKeys(filename);
+            dispatchTable = new OpenAddressing<int, std::string>(probingType, size*2);
+            OpenAddressingTable<int, std::string> runtimeProbe(probingType, size*2);
+            OpenAddressingTable<int, std::string, PairLayout<int, std::string>, WyMixHash<int>, Probe> staticProbe(probingType, size*2);
+            populateStructureAndReturnKeyToRemove(dispatchTable, filename);
+            populateStructureAndReturnKeyToRemove(&runtimeProbe, filename);
+            populateStructureAndReturnKeyToRemove(&staticProbe, filename);
+            timeSearch[0] += timeSearchPass(dispatchTable, keys);
+            timeSearch[1] += timeSearchPass(&runtimeProbe, keys);
+            timeSearch[2] += timeSearchPass(&staticProbe, keys);
+            timeExists[0] += timeMissedLookups(dispatchTable, keys.size());
+            timeExists[1] += timeMissedLookups(&runtimeProbe, keys.size());
+            timeExists[2] += timeMissedLookups(&staticProbe, keys.size());
+            searches += keys.size();
+            delete dispatchTable;
+        }
+        std::string variants[3] = {"Virtual", "Direct", "StaticProbe"};
+        std::cout << "DISPATCH | " << name << " size " << size << ":";
+        for (int v = 0; v < 3; v++) {
+            uint64_t searchNs = searches ? timeSearch[v] / searches : 0;
+            uint64_t existsNs = searches ? timeExists[v] / searches : 0;
+            output << "searchPass;" << name << variants[v] << ";" << size << ";" << searchNs << "\n";
+            output << "existsMiss;" << name << variants[v] << ";" << size << ";" << existsNs << "\n";
+            std::cout << " " << variants[v] << " search " << searchNs << " ns, missed lookup " << existsNs << " ns;";
+        }
+        std::cout << "\n";
+    }
+}
+
+template <typename Hash>
+void compareHashPolicy(std::ofstream &output, std::ofstream &histograms, std::string hashName, int sizes[], int sizeCount, int dataSets[], int setCount) {
+    compareLookups<LinearProbing<PairLayout<int, std::string>, Hash>>(output, "openAddressing" + hashName, "./data1", sizes, sizeCount, dataSets, setCount);
+    compareLookups<ClosedAddressingWithBST<int, std::string, Hash>>(output, "closedAddressing" + hashName, "./data1", sizes, sizeCount, dataSets, setCount);
+    compareLookups<CuckooHashing<int, std::string, PairLayout<int, std::string>, Hash>>(output, "cuckooHashing" + hashName, "./data2", sizes, sizeCount, dataSets, setCount);
+    for (int probingType = 0; probingType < 4; probingType++) {
+        for (int s = 0; s < sizeCount; s++) {
+            std::vector<size_t> histogram;
+            for (int d = 0; d < setCount; d++) {
+                std::string filename = "./data1/zbior_" + std::to_string(dataSets[d]) + "_" + std::to_string(sizes[s]) + ".txt";
+                OpenAddressing<int, std::string, PairLayout<int, std::string>, Hash> structure(probingType, sizes[s]*2);
+                populateStructureAndReturnKeyToRemove(&structure, filename);
+                std::vector<size_t> setHistogram = structure.getProbeLengthHistogram();
+                if (histogram.size() < setHistogram.size()) {
+                    histogram.resize(setHistogram.size(), 0);
+                }
+                for (size_t i = 0; i < setHistogram.size(); i++) {
+                    histogram[i] += setHistogram[i];
+                }
+            }
+            for (size_t i = 0; i < histogram.size(); i++) {
+                histograms << "openAddressingProbingType" << probingType << ";" << hashName << ";" << sizes[s] << ";" << i + 1 << ";" << histogram[i] << "\n";
+            }
+            std::cout << "HASH_POLICY | " << hashName << ", probing type " << probingType << ", size " << sizes[s] << ": longest probe sequence " << histogram.size() << "\n";
+        }
+    }
+}
+
+// Operations timed by the harness on tables built from every data set:
+// batches of inserts of fresh keys, each followed by a batch removing
+// them again, searches of stored keys, missed lookups, and inserting the
+// whole data set into a table starting at 16 slots. The growing inserts
+// are timed one by one, since a batch mean would spread a stop-the-world
+// rehash over the cheap inserts around it.
+template <typename Structure, typename Make>
+void benchmarkStructure(BenchmarkReport &report, std::ofstream &output, const BenchmarkOptions &options, std::string name, std::string dataDir, Make make) {
+    size_t checksum = 0;
+    for (int size : options.sizes) {
+        for (int set : options.dataSets) {
+            std::string filename = dataDir + "/zbior_" + std::to_string(set) + "_" + std::to_string(size) + ".txt";
+            std::vector<int> keys;
+            std::vector<std::string> values;
+            readEntries(filename, keys, values);
+            std::unique_ptr<Structure> structure(make(size * 2));
+            structure->bulkLoad(keys.data(), values.data(), keys.size());
+
+            // Batches stay below a quarter of the table, so the churn does
+            // not make small tables grow
+            size_t churn = std::min(options.batchSize, std::max<size_t>(keys.size() / 4, 1));
+            LatencyHistogram inserts;
+            LatencyHistogram removes;
+            PerfCounters insertCounters;
+            PerfCounters removeCounters;
+            for (size_t b = 0; b < options.warmup + options.batches; b++) {
+                int first = 2000000 + static_cast<int>(b * churn);
+                auto insertBatch = [&]() {
+                    for (size_t j = 0; j < churn; j++) {
+                        structure->insert(first + static_cast<int>(j), "test");
+                    }
+                };
+                auto removeBatch = [&]() {
+                    for (size_t j = 0; j < churn; j++) {
+                        structure->remove(first + static_cast<int>(j));
+                    }
+                };
+                if (b < options.warmup) {
+                    insertBatch();
+                    removeBatch();
+                    continue;
+                }
+                insertCounters.start();
+                inserts.record(timeBatch(churn, insertBatch));
+                insertCounters.stop();
+                removeCounters.start();
+                removes.record(timeBatch(churn, removeBatch));
+                removeCounters.stop();
+            }
+            report.add(name, "insert", size, set, churn, inserts, insertCounters.sample());
+            report.add(name, "remove", size, set, churn, removes, removeCounters.sample());
+
+            std::vector<int> order(keys);
+            std::shuffle(order.begin(), order.end(), std::mt19937(set));
+            size_t batch = options.batchSize;
+            LatencyHistogram hits;
+            PerfCounters hitCounters;
+            timeBatches(hits, hitCounters, options.warmup, options.batches, batch, [&](size_t b) {
+                for (size_t j = 0; j < batch; j++) {
+                    checksum += structure->search(order[(b * batch + j) % order.size()]).size();
+                }
+            });
+            report.add(name, "searchHit", size, set, batch, hits, hitCounters.sample());
+
+            LatencyHistogram misses;
+            PerfCounters missCounters;
+            timeBatches(misses, missCounters, options.warmup, options.batches, batch, [&](size_t b) {
+                for (size_t j = 0; j < batch; j++) {
+                    checksum += structure->exists(3000000 + static_cast<int>((b * batch + j) % 1000000));
+                }
+            });
+            report.add(name, "existsMiss", size, set, batch, misses, missCounters.sample());
+
+            std::unique_ptr<Structure> growing(make(16));
+            LatencyHistogram growth;
+            PerfCounters growthCounters;
+            timeEach(growth, growthCounters, keys.size(), [&](size_t j) {
+                growing->insert(keys[j], values[j]);
+            });
+            report.add(name, "insertGrowing", size, set, 1, growth, growthCounters.sample());
+        }
+        std::cout << "HARNESS | " << name << " size " << size << ":";
+        for (std::string operation : {"insert", "remove", "searchHit", "existsMiss", "insertGrowing"}) {
+            LatencyHistogram merged = report.merged(name, operation, size);
+            double median = merged.percentile(0.5) / 1000.0;
+            double operations = 0;
+            PerfSample counters = report.mergedCounters(name, operation, size, operations);
+            output << operation << ";" << name << ";" << size << ";" << median << perfCsvColumns(counters, operations) << "\n";
+            std::cout << " " << operation << " median " << median << " ns, p99 " << merged.percentile(0.99) / 1000.0 << " ns" << (operation == "insertGrowing" ? "" : " (batch means)") << ";";
+        }
+        std::cout << "\n";
+    }
+    if (checksum == 0) {
+        std::cout << "Empty search results\n";
+    }
+}
+
+// Names the harness knows, every one of them runs unless --structures
+// picks some
+std::vector<std::string> harnessStructures() {
+    std::vector<std::string> names;
+    for (int probingType = 0; probingType < 4; probingType++) {
+        names.push_back("openAddressingProbingType" + std::to_string(probingType));
+        names.push_back("openAddressingProbingType" + std::to_string(probingType) + "Incremental");
+    }
+    for (std::string name : {"closedAddressing", "cuckooHashing", "bucketizedCuckooHashing", "swissTable"}) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+// Call visit(name, dataDir, make) for every structure picked by
+// --structures, make(capacity) building an empty table of it
+template <typename Visit>
+void forEachStructure(const BenchmarkOptions &options, Visit visit) {
+    auto selected = [&](const std::string &name) {
+        return options.structures.empty() || std::find(options.structures.begin(), options.structures.end(), name) != options.structures.end();
+    };
+    for (int probingType = 0; probingType < 4; probingType++) {
+        for (bool incremental : {false, true}) {
+            std::string name = "openAddressingProbingType" + std::to_string(probingType) + (incremental ? "Incremental" : "");
+            if (selected(name)) {
+                visit(name, "./data1", [probingType, incremental](size_t capacity) {
+                    return new OpenAddressing<int, std::string>(probingType, capacity, 0.75f, incremental);
+                });
+            }
+        }
+    }
+    if (selected("closedAddressing")) {
+        visit("closedAddressing", "./data1", [](size_t capacity) {
+            return new ClosedAddressingWithBST<int, std::string>(capacity);
+        });
+    }
+    if (selected("cuckooHashing")) {
+        visit("cuckooHashing", "./data2", [](size_t capacity) {
+            return new CuckooHashing<int, std::string>(capacity);
+        });
+    }
+    // Only `size` slots, the table runs close to full
+    if (selected("bucketizedCuckooHashing")) {
+        visit("bucketizedCuckooHashing", "./data2", [](size_t capacity) {
+            return new BucketizedCuckooHashing<int, std::string>(capacity / 2);
+        });
+    }
+    if (selected("swissTable")) {
+        visit("swissTable", "./data1", [](size_t capacity) {
+            return new SwissTable<int, std::string>(capacity);
+        });
+    }
+}
+
+void runHarness(BenchmarkReport &report, std::ofstream &output, const BenchmarkOptions &options) {
+    forEachStructure(options, [&](std::string name, std::string dataDir, auto make) {
+        using Structure = std::remove_pointer_t<decltype(make(16))>;
+        benchmarkStructure<Structure>(report, output, options, name, dataDir, make);
+    });
+}
+
+// Replay every picked workload on every picked structure, each table
+// loaded with the same records and running the same trace. Intervals go
+// to the workload CSV, the mean time per operation of the whole trace to
+// results.csv.
+void runWorkloads(std::ofstream &output, const BenchmarkOptions &options) {
+    std::vector<WorkloadSpec> workloads;
+    std::vector<std::vector<WorkloadOperation>> traces;
+    std::vector<int> keys;
+    for (const WorkloadSpec &spec : standardWorkloads()) {
+        if (options.workloads.empty() || std::find(options.workloads.begin(), options.workloads.end(), spec.name) != options.workloads.end()) {
+            WorkloadGenerator generator(spec, options.workloadRecords, options.seed);
+            keys = generator.initialKeys();
+            workloads.push_back(spec);
+            traces.push_back(generator.generate(options.workloadOperations));
+        }
+    }
+    std::vector<std::string> values(keys.size(), "record");
+    std::ofstream intervals(options.workloadCsvPath);
+    intervals << "workload;structure;records;interval;operations;opsPerSecond;medianBatchNs;p99BatchNs;p999BatchNs;maxBatchNs;hits;misses;size;loadFactor\n";
+    forEachStructure(options, [&](std::string name, std::string, auto make) {
+        using Structure = std::remove_pointer_t<decltype(make(16))>;
+        for (size_t w = 0; w < workloads.size(); w++) {
+            std::unique_ptr<Structure> structure(make(keys.size() * 2));
+            structure->bulkLoad(keys.data(), values.data(), keys.size());
+            std::vector<WorkloadInterval> results = runWorkload(*structure, traces[w], std::string("update"), options.workloadInterval, options.batchSize);
+            uint64_t picoseconds = 0;
+            for (size_t i = 0; i < results.size(); i++) {
+                const WorkloadInterval &r = results[i];
+                picoseconds += r.picoseconds;
+                intervals << workloads[w].name << ";" << name << ";" << keys.size() << ";" << i << ";" << r.operations << ";" << r.throughput() << ";" << r.batchMeans.percentile(0.5) / 1000.0 << ";" << r.batchMeans.percentile(0.99) / 1000.0 << ";" << r.batchMeans.percentile(0.999) / 1000.0 << ";" << r.batchMeans.max() / 1000.0 << ";" << r.hits << ";" << r.misses << ";" << r.size << ";" << r.loadFactor << "\n";
+            }
+            double meanNs = picoseconds / 1000.0 / traces[w].size();
+            output << "workload" << workloads[w].name << ";" << name << ";" << keys.size() << ";" << meanNs << "\n";
+            std::cout << "WORKLOAD | " << workloads[w].name << " on " << name << ": " << meanNs << " ns per operation, throughput first interval " << results.front().throughput() << " ops/s, last interval " << results.back().throughput() << " ops/s, worst batch p99 ";
+            uint64_t worst = 0;
+            for (const WorkloadInterval &r : results) {
+                worst = std::max(worst, r.batchMeans.percentile(0.99));
+            }
+            std::cout << worst / 1000.0 << " ns\n";
+        }
+    });
+    if (!intervals) {
+        throw std::runtime_error("Cannot write " + options.workloadCsvPath);
+    }
+}
+
+// Shape of every structure after loading each data set, and again after
+// as many fresh keys were inserted and removed one by one, so tombstones
+// and displaced keys show up
+void reportTableStats(const BenchmarkOptions &options) {
+    std::ofstream output("table_stats.csv");
+    output << "structure;phase;size;dataSet;elements;capacity;loadFactor;tombstones;bytes;probeMean;probeMax;displacementMean;displacementMax;evictions;rehashes;bucketKeysMean;bucketKeysMax;treeHeightMax\n";
+    auto histogramColumns = [&](const std::vector<size_t> &histogram, size_t offset) {
+        if (histogram.empty()) {
+            output << ";;";
+        } else {
+            output << ";" << histogramMean(histogram) + offset << ";" << histogram.size() - 1 + offset;
+        }
+    };
+    forEachStructure(options, [&](std::string name, std::string dataDir, auto make) {
+        using Structure = std::remove_pointer_t<decltype(make(16))>;
+        for (int size : options.sizes) {
+            for (int set : options.dataSets) {
+                std::string filename = dataDir + "/zbior_" + std::to_string(set) + "_" + std::to_string(size) + ".txt";
+                std::vector<int> keys;
+                std::vector<std::string> values;
+                readEntries(filename, keys, values);
+                std::unique_ptr<Structure> structure(make(size * 2));
+                structure->bulkLoad(keys.data(), values.data(), keys.size());
+                for (std::string phase : {"loaded", "churned"}) {
+                    if (phase == "churned") {
+                        for (int j = 0; j < size; j++) {
+                            structure->insert(3000000 + j, "churn");
+                            structure->remove(3000000 + j);
+                        }
+                    }
+                    TableStats stats = structure->stats();
+                    output << name << ";" << phase << ";" << size << ";" << set << ";" << stats.elements << ";" << stats.capacity << ";" << stats.loadFactor << ";" << stats.tombstones << ";" << stats.bytesUsed;
+                    histogramColumns(stats.probeLengths, 1);
+                    histogramColumns(stats.displacementChains, 0);
+                    output << ";" << stats.evictions << ";" << stats.rehashes;
+                    histogramColumns(stats.bucketOccupancy, 0);
+                    output << ";" << (stats.treeHeights.empty() ? 0 : stats.treeHeights.size() - 1) << "\n";
+                    if (set == options.dataSets.front()) {
+                        std::cout << "STATS | " << name << " size " << size << " " << phase << ": " << stats << "\n";
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Composite keys through the public HashTable aliases, which instantiate
+// every virtual member, printing included. Pairs holding the old -1 and -2
+// sentinels must be stored like any other key.
+bool checkPairKeys(HashTable<std::pair<int, int>, int> &structure) {
+    for (int i = -2; i < 200; i++) {
+        structure.insert({i, -i}, i);
+    }
+    for (int i = -2; i < 200; i += 2) {
+        structure.remove({i, -i});
+    }
+    bool ok = structure.size() == 101 && !structure.exists({-1, 2});
+    for (int i = -2; i < 200; i++) {
+        bool stored = i % 2 != 0;
+        ok = ok && structure.exists({i, -i}) == stored && (!stored || structure.search({i, -i}) == i);
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkOptions options;
+    try {
+        options = parseBenchmarkOptions(argc, argv);
+        std::vector<std::string> known = harnessStructures();
+        for (const std::string &name : options.structures) {
+            if (std::find(known.begin(), known.end(), name) == known.end()) {
+                throw std::invalid_argument("Unknown structure " + name);
+            }
+        }
+        std::vector<WorkloadSpec> workloads = standardWorkloads();
+        for (const std::string &name : options.workloads) {
+            if (std::find_if(workloads.begin(), workloads.end(), [&](const WorkloadSpec &spec) { return spec.name == name; }) == workloads.end()) {
+                throw std::invalid_argument("Unknown workload " + name);
+            }
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n" << benchmarkUsage();
+        return 1;
+    }
+    if (options.help) {
+        std::cout << benchmarkUsage();
+        return 0;
+    }
+    if (options.cpu >= 0 && !pinToCpu(options.cpu)) {
+        std::cerr << "Cannot pin to CPU " << options.cpu << "\n";
+        return 1;
+    }
+    OpenAddressing<std::pair<int, int>, int> pairOpenAddressing(0, 16);
+    CuckooHashing<std::pair<int, int>, int> pairCuckoo(16);
+    if (!checkPairKeys(pairOpenAddressing) || !checkPairKeys(pairCuckoo)) {
+        std::cerr << "Tables with std::pair keys lost or invented entries\n";
+        return 1;
+    }
+    if (PERF_COUNTERS_ENABLED && !PerfCounters().available()) {
+        std::cerr << "Hardware counters unavailable, check /proc/sys/kernel/perf_event_paranoid; the counter columns read nan\n";
+    }
+
     std::cout << "Starting structure testing...\n";
     std::ofstream output("results.csv");
-    output << "action;structure;size;timeNs\n";
+    // Only the harness rows fill the hardware counter columns
+    output << "action;structure;size;timeNs" << perfCsvHeader() << "\n";
     int line = 0;
 
-    int dataSets[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
-    int sizes[] = {1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000, 256000, 512000};
+    int *sizes = options.sizes.data();
+    int *dataSets = options.dataSets.data();
+    int sizeCount = options.sizes.size();
+    int setCount = options.dataSets.size();
 
     auto mainStart = std::chrono::high_resolution_clock::now();
 
-    // Open Addressing, Insertion and Deletion
-    for (int probingType = 0; probingType < 3; probingType++) {
-        std::cout << "Open Addressing, probing type: " << probingType << "\n";
-        for (int size : sizes){
-            uint64_t timeInsert = 0;
-            uint64_t timeRemove = 0;
-            for (int set : dataSets) {
+    // Insert, remove, search and missed lookup latencies of every structure,
+    // timed in batches, then throughput and the tail of batch means over
+    // time under mixed workloads
+    BenchmarkReport report;
+    try {
+        runHarness(report, output, options);
+        report.writeCsv(options.csvPath);
+        report.writeJson(options.jsonPath);
+        runWorkloads(output, options);
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (options.harnessOnly) {
+        output.close();
+        return 0;
+    }
+
+    // Probe, displacement and bucket statistics of every structure
+    reportTableStats(options);
+
+    // Open Addressing, lookup misses after a long insert/remove churn
+    for (int probingType = 0; probingType < 4; probingType++) {
+        for (int size : options.sizes){
+            uint64_t timeExists = 0;
+            size_t tombstones = 0;
+            for (int set : options.dataSets) {
                 std::string filename = "./data1/zbior_" + std::to_string(set) + "_" + std::to_string(size) + ".txt";
                 openAddressing = new OpenAddressing<int, std::string>(probingType, size*2);
-                int keyToRemove = populateStructureAndReturnKeyToRemove(openAddressing, filename);
-                std::cout << "Open Addressing, probing type: " << probingType << ", size: " << size << ", set: " << set << "\n";
-                for (int j = 1; j <= 100; j++){
-                    OpenAddressing<int, std::string> *copy = new OpenAddressing<int, std::string>(*openAddressing);
-                    std::cout << "OPEN_ADDRESSING | Performing insert for size: " << size << ", set: " << set;
-                    timeInsert += performInsertion(copy, rand()%1000000 + 1, "test");
-                    delete copy;
-                    OpenAddressing<int, std::string> *copyRemove = new OpenAddressing<int, std::string>(*openAddressing);
-                    std::cout << "OPEN_ADDRESSING | Performing remove for size: " << size << ", set: " << set;
-                    timeRemove += performRemoval(copyRemove, keyToRemove);
-                    delete copyRemove;
+                populateStructureAndReturnKeyToRemove(openAddressing, filename);
+                for (int j = 0; j < size * 4; j++) {
+                    openAddressing->insert(3000000 + j, "churn");
+                    openAddressing->remove(3000000 + j);
                 }
+                tombstones += openAddressing->getTombstoneCount();
+                timeExists += timeMissedLookups(openAddressing, 1000);
                 delete openAddressing;
             }
-            output << "insert;openAddressingProbingType"<< probingType << ";" << size << ";" << timeInsert / 1000 << "\n";
-            std::cout << "OPEN_ADDRESSING | Insertion time for probing type " << probingType << " and size " << size << ": " << timeInsert / 1000 << " ns\n";
-            output << "remove;openAddressingProbingType"<< probingType << ";" << size << ";" << timeRemove / 1000 << "\n";
-            std::cout << "OPEN_ADDRESSING | Removal time for probing type " << probingType << " and size " << size << ": " << timeRemove / 1000 << " ns\n";
-        }
-    }
-
-    // Closed Addressing, Insertion and Deletion
-    for (int size : sizes){
-        uint64_t timeInsert = 0;
-        uint64_t timeRemove = 0;
-        for (int set : dataSets) {
-            std::string filename = "./data1/zbior_" + std::to_string(set) + "_" + std::to_string(size) + ".txt";
-            int keyToRemove;
-            std::cout << "Closed Addressing, size: " << size << ", set: " << set << "\n";
-            for (int j = 1; j <= 100; j++){
-                closedAddressing = new ClosedAddressingWithBST<int, std::string>(size*2);
-                keyToRemove = populateStructureAndReturnKeyToRemove(closedAddressing, filename);
-                std::cout << "CLOSED_ADDRESSING | Performing insert for size: " << size << ", set: " << set;
-                timeInsert += performInsertion(closedAddressing, rand()%1000000 + 1, "test");
-                delete closedAddressing;
-                closedAddressing = new ClosedAddressingWithBST<int, std::string>(size*2);
-                keyToRemove = populateStructureAndReturnKeyToRemove(closedAddressing, filename);
-                std::cout << "CLOSED_ADDRESSING | Performing remove for size: " << size << ", set: " << set;
-                timeRemove += performRemoval(closedAddressing, keyToRemove);
-                delete closedAddressing;
-            }
-        }
-        output << "insert;closedAddressing;" << size << ";" << timeInsert / 1000 << "\n";
-        std::cout << "CLOSED_ADDRESSING | Insertion time for size " << size << ": " << timeInsert / 1000 << " ns\n";
-        output << "remove;closedAddressing;" << size << ";" << timeRemove / 1000 << "\n";
-        std::cout << "CLOSED_ADDRESSING | Removal time for size " << size << ": " << timeRemove / 1000 << " ns\n";
-    }
-
-    // Cuckoo Hashing, Insertion and Deletion
-    for (int size : sizes){
-        uint64_t timeInsert = 0;
-        uint64_t timeRemove = 0;
-        for (int set : dataSets) {
-            std::string filename = "./data2/zbior_" + std::to_string(set) + "_" + std::to_string(size) + ".txt";
-            std::cout << "Cuckoo Hashing, size: " << size << ", set: " << set << "\n";
-            cuckooHashing = new CuckooHashing<int, std::string>(size*2);
-            int keyToRemove = populateStructureAndReturnKeyToRemove(cuckooHashing, filename);
-            for (int j = 1; j <= 100; j++){
-                CuckooHashing<int, std::string> *copy = new CuckooHashing<int, std::string>(*cuckooHashing);
-                std::cout << "CUCKOO_HASHING | Performing insert for size: " << size << ", set: " << set;
-                timeInsert += performInsertion(copy, rand()%1000000 + 1, "test");
-                delete copy;
-                CuckooHashing<int, std::string> *copyRemove = new CuckooHashing<int, std::string>(*cuckooHashing);
-                std::cout << "CUCKOO_HASHING | Performing remove for size: " << size << ", set: " << set;
-                timeRemove += performRemoval(copyRemove, keyToRemove);
-                delete copyRemove;
-            }
-            delete cuckooHashing;
-        }
-        output << "insert;cuckooHashing;" << size << ";" << timeInsert / 1000 << "\n";
-        std::cout << "CUCKOO_HASHING | Insertion time for size " << size << ": " << timeInsert / 1000 << " ns\n";
-        output << "remove;cuckooHashing;" << size << ";" << timeRemove / 1000 << "\n";
-        std::cout << "CUCKOO_HASHING | Removal time for size " << size << ": " << timeRemove / 1000 << " ns\n";
+            output << "existsAfterChurn;openAddressingProbingType" << probingType << ";" << size << ";" << timeExists / (1000 * setCount) << "\n";
+            std::cout << "OPEN_ADDRESSING | Miss lookup time after churn for probing type " << probingType << " and size " << size << ": " << timeExists / (1000 * setCount) << " ns, tombstones left: " << tombstones / setCount << "\n";
+        }
     }
 
+    // Slot layouts, array of pairs against separate key and value arrays
+    compareLookups<LinearProbing<PairLayout<int, std::string>>>(output, "openAddressingPairLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareLookups<LinearProbing<SplitLayout<int, std::string>>>(output, "openAddressingSplitLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareLookups<CuckooHashing<int, std::string, PairLayout<int, std::string>>>(output, "cuckooHashingPairLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareLookups<CuckooHashing<int, std::string, SplitLayout<int, std::string>>>(output, "cuckooHashingSplitLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareLookups<LinearProbing<ArenaLayout<int>>>(output, "openAddressingArenaLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareLookups<CuckooHashing<int, std::string, ArenaLayout<int>>>(output, "cuckooHashingArenaLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareLookups<LinearProbing<PagedLayout<int, std::string>>>(output, "openAddressingPagedLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+
+    // Copying a table, one std::string per slot against flat arena slots
+    // and against shared copy-on-write pages
+    compareCopies<LinearProbing<PairLayout<int, std::string>>>(output, "openAddressingPairLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareCopies<LinearProbing<ArenaLayout<int>>>(output, "openAddressingArenaLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareCopies<LinearProbing<PagedLayout<int, std::string>>>(output, "openAddressingPagedLayout", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareCopies<CuckooHashing<int, std::string, PairLayout<int, std::string>>>(output, "cuckooHashingPairLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareCopies<CuckooHashing<int, std::string, ArenaLayout<int>>>(output, "cuckooHashingArenaLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareCopies<CuckooHashing<int, std::string, PagedLayout<int, std::string>>>(output, "cuckooHashingPagedLayout", "./data2", sizes, sizeCount, dataSets, setCount);
+
+    // Hash policies, lookup times and probe length histograms
+    std::ofstream histograms("probe_histograms.csv");
+    histograms << "structure;hash;size;probes;keys\n";
+    compareHashPolicy<IdentityHash<int>>(output, histograms, "IdentityHash", sizes, sizeCount, dataSets, setCount);
+    compareHashPolicy<FibonacciHash<int>>(output, histograms, "FibonacciHash", sizes, sizeCount, dataSets, setCount);
+    compareHashPolicy<WyMixHash<int>>(output, histograms, "WyMixHash", sizes, sizeCount, dataSets, setCount);
+    histograms.close();
+
+    // Cost of virtual dispatch and of choosing the probe sequence at run time
+    compareDispatch<LinearProbe>(output, 0, sizes, sizeCount, dataSets, setCount);
+    compareDispatch<QuadraticProbe>(output, 1, sizes, sizeCount, dataSets, setCount);
+    compareDispatch<DoubleHashProbe>(output, 2, sizes, sizeCount, dataSets, setCount);
+    compareDispatch<RobinHoodProbe>(output, 3, sizes, sizeCount, dataSets, setCount);
+
+    // Batched lookups with prefetching against a loop of single calls,
+    // half of the looked up keys missing
+    compareBatchLookups<LinearProbing<PairLayout<int, std::string>>>(output, "openAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareBatchLookups<CuckooHashing<int, std::string>>(output, "cuckooHashing", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareBatchLookups<ClosedAddressingWithBST<int, std::string>>(output, "closedAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+
+    // Parsing the dataset files, the line by line reader against the
+    // mapped one; earlier sections left the files in the page cache
+    compareLoaders(output, "./data1", 256000, dataSets, setCount);
+
+    // Restarting from a binary snapshot instead of the text files
+    compareSnapshots<LinearProbing<PairLayout<int, std::string>>, OpenAddressingSnapshot<int, std::string>>(output, "openAddressing", "./data1", 256000, dataSets, setCount);
+    compareSnapshots<CuckooHashing<int, std::string>, CuckooSnapshot<int, std::string>>(output, "cuckooHashing", "./data2", 256000, dataSets, setCount);
+    compareSnapshots<ClosedAddressingWithBST<int, std::string>>(output, "closedAddressing", "./data1", 256000, dataSets, setCount);
+
+    // Building a table with one bulkLoad against one insert per entry
+    compareBulkLoad<LinearProbing<PairLayout<int, std::string>>>(output, "openAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareBulkLoad<RobinHoodProbing<PairLayout<int, std::string>>>(output, "openAddressingRobinHood", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareBulkLoad<ClosedAddressingWithBST<int, std::string>>(output, "closedAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareBulkLoad<CuckooHashing<int, std::string>>(output, "cuckooHashing", "./data2", sizes, sizeCount, dataSets, setCount);
+    compareBulkLoad<SwissTable<int, std::string>>(output, "swissTable", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareBulkLoad<ConcurrentClosedAddressingWithBST<int, std::string>>(output, "concurrentClosedAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+
+    // Concurrent tables, throughput from one thread up to every core
+    stressConcurrent<ConcurrentClosedAddressingWithBST<int, std::string>>("concurrentClosedAddressing");
+    stressConcurrent<ConcurrentOpenAddressing<int, std::string>>("concurrentOpenAddressing");
+    stressConcurrent<ConcurrentCuckooHashing<int, std::string>>("concurrentCuckoo");
+    churnConcurrent<ConcurrentOpenAddressing<int, std::string>>("concurrentOpenAddressing");
+    compareConcurrent<ConcurrentClosedAddressingWithBST<int, std::string>>(output, "concurrentClosedAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareConcurrent<ConcurrentOpenAddressing<int, std::string>>(output, "concurrentOpenAddressing", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareConcurrent<ConcurrentCuckooHashing<int, std::string>>(output, "concurrentCuckoo", "./data1", sizes, sizeCount, dataSets, setCount);
+    compareConcurrent<GlobalLock<LinearProbing<PairLayout<int, std::string>>>>(output, "openAddressingGlobalLock", "./data1", sizes, sizeCount, dataSets, setCount);
+
     output.close();
 
     auto mainEnd = std::chrono::high_resolution_clock::now();